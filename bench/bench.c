@@ -0,0 +1,467 @@
+/*
+benchmarks both stages of mite on a generated site
+
+	cc -O2 -o bench/bench bench/bench.c && ./bench/bench --pages 1000 -j 8
+
+the site is generated once per configuration into .mite-bench/, every phase
+is run --repeat times and the results are printed as tab separated lines:
+
+	phase <tab> median ms <tab> min ms <tab> bytes
+
+so the output of two versions can be diffed or compared by a script.
+*/
+
+#define MITE_NO_MAIN
+#include "../mite.c"
+
+#ifndef _WIN32
+	#include <limits.h>
+#else
+	#include <io.h>
+	#include <direct.h>
+	#define dup _dup
+	#define dup2 _dup2
+	#define close _close
+	#define chdir _chdir
+#endif
+
+typedef struct {
+	size_t pages;
+	size_t layouts;
+	size_t includes;
+	size_t front_matter; // bytes of PAGE_SET data per page
+	size_t code;         // code blocks per page
+	size_t inline_mix;   // paragraphs of unbalanced inline markup per page
+	size_t repeat;
+	size_t jobs;
+	bool compile;
+	const char* dir;
+	const char* source;
+} BenchConfig;
+
+typedef struct {
+	const char* name;
+	double samples_ms[64];
+	size_t count;
+	uint64_t bytes;
+} BenchPhase;
+
+typedef struct {
+	BenchPhase* items;
+	size_t count;
+	size_t capacity;
+} BenchPhases;
+
+static BenchPhase* bench_phase(BenchPhases* phases, const char* name) {
+	for (size_t i = 0; i < phases->count; ++i) {
+		if (0 == strcmp(phases->items[i].name, name)) return &phases->items[i];
+	}
+	da_append(phases, ((BenchPhase){ .name = name }));
+	return &phases->items[phases->count - 1];
+}
+
+static void bench_record(BenchPhases* phases, const char* name, uint64_t start, uint64_t end, uint64_t bytes) {
+	BenchPhase* p = bench_phase(phases, name);
+	if (p->count < sizeof(p->samples_ms) / sizeof(p->samples_ms[0])) {
+		p->samples_ms[p->count++] = (double)(end - start) / 1e6;
+	}
+	p->bytes = bytes;
+}
+
+static int compare_double(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// mite and the generated site print every page, only the results should reach stdout
+static int bench_stdout = -1;
+static void bench_quiet(bool quiet) {
+	fflush(stdout);
+	if (quiet) {
+		bench_stdout = dup(1);
+#ifndef _WIN32
+		FILE* null = fopen("/dev/null", "w");
+#else
+		FILE* null = fopen("NUL", "w");
+#endif
+		if (!null) return;
+		dup2(fileno(null), 1);
+		fclose(null);
+	} else if (bench_stdout >= 0) {
+		dup2(bench_stdout, 1);
+		close(bench_stdout);
+		bench_stdout = -1;
+	}
+}
+
+// the loop da_append_escape_html replaced, one character at a time, as the baseline
+static void bench_escape_scalar(StringBuilder* out, const char* in, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		switch ((unsigned char)in[i]) {
+			case '<':  da_append_cstr(out, "&lt;");   break;
+			case '>':  da_append_cstr(out, "&gt;");   break;
+			case '&':  da_append_cstr(out, "&amp;");  break;
+			case '\'': da_append_cstr(out, "&#39;");  break;
+			case '"':  da_append_cstr(out, "&quot;"); break;
+			default:   da_append(out, in[i]);         break;
+		}
+	}
+}
+
+// what STR() and code blocks escape, text with a special character every 64, 16 or 4 bytes
+static void bench_escape(BenchPhases* phases, size_t repeat) {
+	static const struct { size_t every; const char* name; const char* scalar; } densities[] = {
+		{ 0,  "escape_html_none",  "escape_scalar_none"  },
+		{ 64, "escape_html_1in64", "escape_scalar_1in64" },
+		{ 16, "escape_html_1in16", "escape_scalar_1in16" },
+		{ 4,  "escape_html_1in4",  "escape_scalar_1in4"  },
+	};
+	const size_t size = 4*1024*1024;
+	const char specials[] = "<>&'\"";
+	char* text = malloc(size);
+	StringBuilder out = {0}, expected = {0};
+	for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); ++d) {
+		for (size_t i = 0; i < size; ++i) {
+			size_t every = densities[d].every;
+			char c = i % 7 == 6 ? ' ' : (char)('a' + i % 26);
+			text[i] = every && i % every == every - 1 ? specials[(i / every) % 5] : c;
+		}
+		for (size_t r = 0; r < repeat; ++r) {
+			out.count = 0;
+			uint64_t start = timing_now_ns();
+			da_append_escape_html(&out, text, size);
+			bench_record(phases, densities[d].name, start, timing_now_ns(), size);
+
+			expected.count = 0;
+			start = timing_now_ns();
+			bench_escape_scalar(&expected, text, size);
+			bench_record(phases, densities[d].scalar, start, timing_now_ns(), size);
+		}
+		if (out.count != expected.count || 0 != memcmp(out.items, expected.items, out.count)) {
+			fprintf(stderr, "[error] %s differs from the scalar escape\n", densities[d].name);
+		}
+	}
+	free(expected.items);
+	free(out.items);
+	free(text);
+}
+
+// deterministic, so the same configuration always produces the same site
+static uint32_t bench_random_state = 2463534242u;
+static uint32_t bench_random(void) {
+	bench_random_state ^= bench_random_state << 13;
+	bench_random_state ^= bench_random_state >> 17;
+	bench_random_state ^= bench_random_state << 5;
+	return bench_random_state;
+}
+
+static const char* bench_words[] = {
+	"mite", "static", "site", "generator", "page", "template", "layout", "render",
+	"markdown", "compile", "cache", "thread", "output", "html", "string", "buffer",
+};
+#define BENCH_WORDS (sizeof(bench_words) / sizeof(bench_words[0]))
+
+static void bench_sentence(StringBuilder* sb, size_t words) {
+	for (size_t i = 0; i < words; ++i) {
+		if (i) da_append(sb, ' ');
+		const char* word = bench_words[bench_random() % BENCH_WORDS];
+		switch (bench_random() % 16) {
+		case 0:  da_append_cstr(sb, "**"); da_append_cstr(sb, word); da_append_cstr(sb, "**"); break;
+		case 1:  da_append(sb, '*');       da_append_cstr(sb, word); da_append(sb, '*');       break;
+		case 2:  da_append(sb, '`');       da_append_cstr(sb, word); da_append(sb, '`');       break;
+		case 3:  da_append(sb, '[');       da_append_cstr(sb, word); da_append_cstr(sb, "](/post/)"); break;
+		case 4:  da_append_cstr(sb, word); da_append_cstr(sb, " & <b>"); break;
+		default: da_append_cstr(sb, word); break;
+		}
+	}
+}
+
+// openers without closers make every inline search run to the end of the line
+static void bench_pathological(StringBuilder* sb, size_t words) {
+	static const char* marks[] = { "*", "**", "_", "`", "[", "](", "<", "~~", "$" };
+	for (size_t i = 0; i < words; ++i) {
+		da_append_cstr(sb, marks[bench_random() % (sizeof(marks) / sizeof(marks[0]))]);
+		da_append_cstr(sb, bench_words[bench_random() % BENCH_WORDS]);
+		da_append(sb, ' ');
+	}
+	da_append(sb, '\n');
+}
+
+static bool bench_write(const char* path, StringBuilder* sb) {
+	bool ok = write_to_file(path, sb);
+	if (!ok) fprintf(stderr, "[error] could not write %s\n", path);
+	sb->count = 0;
+	return ok;
+}
+
+static bool bench_generate(BenchConfig* c) {
+	char path[MAX_PATH_LEN];
+	StringBuilder sb = {0};
+	bool ok = make_directory("layout") && make_directory("include") && make_directory("post");
+
+	for (size_t i = 0; ok && i < c->includes; ++i) {
+		da_append_cstr(&sb, "<div class=\"include\">\n");
+		da_append_cstr(&sb, "<? for (size_t i = 0; i < global.socials.count; ++i) { ?>\n");
+		da_append_cstr(&sb, "\t<a href=\"<? STR(global.socials.items[i]->url) ?>\"><? STR(global.socials.items[i]->title) ?></a>\n");
+		da_append_cstr(&sb, "<? } ?>\n<p>");
+		bench_sentence(&sb, 24);
+		da_append_cstr(&sb, "</p>\n</div>\n");
+		snprintf(path, sizeof(path), "include/inc%d.mite", (int)i);
+		ok = bench_write(path, &sb);
+	}
+
+	for (size_t i = 0; ok && i < c->layouts; ++i) {
+		da_append_cstr(&sb, "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n\t<meta charset=\"UTF-8\">\n");
+		da_append_cstr(&sb, "\t<title><? STR(page->title) ?></title>\n</head>\n<body>\n");
+		da_append_cstr(&sb, "\t<header><h1><? STR(page->title) ?></h1><p><? STR(page->date) ?></p></header>\n");
+		da_append_cstr(&sb, "\t<main><? CONTENT() ?></main>\n");
+		for (size_t k = 0; k < c->includes && k < 4; ++k) {
+			snprintf(path, sizeof(path), "\t<? INCLUDE(\"inc%d\") ?>\n", (int)((i + k) % c->includes));
+			da_append_cstr(&sb, path);
+		}
+		da_append_cstr(&sb, "</body>\n</html>\n");
+		snprintf(path, sizeof(path), "layout/l%d.mite", (int)i);
+		ok = bench_write(path, &sb);
+	}
+
+	da_append_cstr(&sb, "```c\nglobal.title = \"bench\";\npage->layout = \"l0\";\n");
+	da_append_cstr(&sb, "ADD_SOCIAL(\"github\", \"https://github.com/user\");\nADD_SOCIAL(\"rss\", \"/rss.xml\");\n```\n\n");
+	da_append_cstr(&sb, "<ul>\n<? sort_pages(&global.posts); ?>\n<? for (size_t i = 0; i < global.posts.count; ++i) { ?>\n");
+	da_append_cstr(&sb, "<li><a href=\"<? STR(global.posts.items[i]->url) ?>\"><? STR(global.posts.items[i]->title) ?></a></li>\n");
+	da_append_cstr(&sb, "<? } ?>\n</ul>\n");
+	ok = ok && bench_write("index.md", &sb);
+
+	for (size_t i = 0; ok && i < c->pages; ++i) {
+		snprintf(path, sizeof(path), "post/p%d", (int)i);
+		if (!make_directory(path)) { ok = false; break; }
+
+		char line[256];
+		snprintf(line, sizeof(line),
+			"```c\npage->layout = \"l%d\";\npage->title = \"post %d\";\npage->date = \"20%02d-%02d-%02d\";\npage->tags = \"bench\";\n",
+			(int)(c->layouts ? i % c->layouts : 0), (int)i, (int)(10 + i % 15), (int)(1 + i % 12), (int)(1 + i % 28));
+		da_append_cstr(&sb, line);
+		for (size_t k = 0, written = 0; written < c->front_matter; ++k) {
+			size_t start = sb.count;
+			snprintf(line, sizeof(line), "PAGE_SET(\"key%d\", \"", (int)k);
+			da_append_cstr(&sb, line);
+			bench_sentence(&sb, 6);
+			da_append_cstr(&sb, "\");\n");
+			written += sb.count - start;
+		}
+		da_append_cstr(&sb, "SET_POST();\n```\n\n");
+
+		snprintf(line, sizeof(line), "# post %d\n\n", (int)i);
+		da_append_cstr(&sb, line);
+		for (size_t k = 0; k < 6; ++k) {
+			bench_sentence(&sb, 60);
+			da_append_cstr(&sb, "\n\n");
+			if (k < c->code) {
+				da_append_cstr(&sb, "```c\nfor (int i = 0; i < n; ++i) {\n\tif (a[i] < b && c > d) sum += a[i] * 2;\n}\n```\n\n");
+			}
+		}
+		for (size_t k = 6; k < c->code; ++k) {
+			da_append_cstr(&sb, "```\n<tag attr=\"value\"> & more </tag>\n```\n\n");
+		}
+		for (size_t k = 0; k < c->inline_mix; ++k) {
+			bench_pathological(&sb, 80);
+			da_append(&sb, '\n');
+		}
+		snprintf(path, sizeof(path), "post/p%d/p%d.md", (int)i, (int)i);
+		ok = bench_write(path, &sb);
+	}
+	free(sb.items);
+	return ok;
+}
+
+static void bench_usage(const char* prog) {
+	printf("usage: %s [options]\n", prog);
+	printf("  --pages <N>         generated pages (default: 200)\n");
+	printf("  --layouts <N>       generated layouts (default: 4)\n");
+	printf("  --includes <N>      generated includes (default: 8)\n");
+	printf("  --front-matter <N>  bytes of PAGE_SET data per page (default: 256)\n");
+	printf("  --code <N>          code blocks per page (default: 2)\n");
+	printf("  --inline <N>        paragraphs of unbalanced inline markup per page (default: 0)\n");
+	printf("  --repeat <N>        runs of every phase, the median is reported (default: 5)\n");
+	printf("  -j <N>              threads for the threaded phases (default: 1)\n");
+	printf("  --no-compile        skip compiling and running the generated site\n");
+	printf("  --dir <PATH>        where the sites are generated (default: .mite-bench)\n");
+	printf("  --source <PATH>     mite.c to benchmark (default: ./mite.c)\n");
+}
+
+int main(int argc, char** argv) {
+	BenchConfig c = {
+		.pages = 200, .layouts = 4, .includes = 8, .front_matter = 256, .code = 2, .inline_mix = 0,
+		.repeat = 5, .jobs = 1, .compile = true, .dir = ".mite-bench", .source = "mite.c",
+	};
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		bool value = i + 1 < argc;
+		if      (value && 0 == strcmp(arg, "--pages"))        c.pages        = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "--layouts"))      c.layouts      = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "--includes"))     c.includes     = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "--front-matter")) c.front_matter = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "--code"))         c.code         = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "--inline"))       c.inline_mix   = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "--repeat"))       c.repeat       = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "-j"))             c.jobs         = (size_t)atoi(argv[++i]);
+		else if (value && 0 == strcmp(arg, "--dir"))          c.dir          = argv[++i];
+		else if (value && 0 == strcmp(arg, "--source"))       c.source       = argv[++i];
+		else if (0 == strcmp(arg, "--no-compile"))            c.compile      = false;
+		else { bench_usage(argv[0]); return 1; }
+	}
+	if (c.layouts < 1) c.layouts = 1;
+	if (c.jobs < 1) c.jobs = 1;
+	if (c.repeat < 1) c.repeat = 1;
+	if (c.repeat > 64) c.repeat = 64;
+
+	// site.c includes mite.c from inside the generated site
+	char source[MAX_PATH_LEN];
+#ifndef _WIN32
+	if (!realpath(c.source, source)) {
+#else
+	if (!_fullpath(source, c.source, sizeof(source))) {
+#endif
+		fprintf(stderr, "[error] mite.c not found at '%s', use --source\n", c.source);
+		return 1;
+	}
+
+	char site_dir[MAX_PATH_LEN];
+	snprintf(site_dir, sizeof(site_dir), "%s/p%d-l%d-i%d-f%d-c%d-x%d", c.dir,
+		(int)c.pages, (int)c.layouts, (int)c.includes, (int)c.front_matter, (int)c.code, (int)c.inline_mix);
+	bool exists = file_exists(site_dir);
+	if (!make_directory(c.dir) || !make_directory(site_dir) || 0 != chdir(site_dir)) {
+		fprintf(stderr, "[error] could not create %s\n", site_dir);
+		return 1;
+	}
+	if (!exists && !bench_generate(&c)) return 1;
+
+	BenchPhases phases = {0};
+	MiteGenerator m = { .mite_source_path = source, .arg_jobs = c.jobs };
+	bench_quiet(true);
+
+	for (size_t r = 0; r < c.repeat; ++r) {
+		free_mite_sources(&m);
+		uint64_t start = timing_now_ns();
+		mite_search(&m);
+		bench_record(&phases, "search_files", start, timing_now_ns(), 0);
+	}
+
+	// the markdown is read once, only the conversions are measured
+	size_t count = m.pages.count;
+	StringBuilder* md = calloc(count + 1, sizeof(StringBuilder));
+	StringBuilder* html = calloc(count + 1, sizeof(StringBuilder));
+	StringBuilder* fm = calloc(count + 1, sizeof(StringBuilder));
+	uint64_t md_bytes = 0;
+	for (size_t i = 0; i < count; ++i) {
+		read_entire_file(m.pages.items[i].md_path, &md[i]);
+		md_bytes += md[i].count;
+		da_append(&md[i], '\0');
+	}
+
+	uint64_t html_bytes = 0, c_bytes = 0;
+	StringBuilder code = {0}, chunks = {0};
+	for (size_t r = 0; r < c.repeat; ++r) {
+		uint64_t start = timing_now_ns();
+		for (size_t i = 0; i < count; ++i) {
+			html[i].count = fm[i].count = 0;
+			render_md_to_html(&md[i], &html[i], &fm[i], NULL);
+		}
+		bench_record(&phases, "render_md_to_html", start, timing_now_ns(), md_bytes);
+
+		html_bytes = c_bytes = 0;
+		start = timing_now_ns();
+		for (size_t i = 0; i < count; ++i) {
+			code.count = chunks.count = 0;
+			render_html_to_c(SB_TO_SV(&html[i]), &code, &chunks, NULL);
+			render_html_to_c(SB_TO_SV(&fm[i]), &code, NULL, NULL);
+			html_bytes += html[i].count + fm[i].count;
+			c_bytes += code.count + chunks.count;
+		}
+		bench_record(&phases, "render_html_to_c", start, timing_now_ns(), html_bytes);
+	}
+	bench_escape(&phases, c.repeat);
+
+	// the whole first stage as mite_build runs it, reading the files on `jobs` threads
+	for (size_t r = 0; r < c.repeat; ++r) {
+		for (size_t i = 0; i < m.templates.count; ++i) m.templates.items[i].rendered_code.count = 0;
+		uint64_t start = timing_now_ns();
+		render_templates(&m.templates, c.jobs);
+		bench_record(&phases, "render_templates", start, timing_now_ns(), 0);
+
+		for (size_t i = 0; i < count; ++i) {
+			m.pages.items[i].dirty = true;
+			m.pages.items[i].rendered = false;
+		}
+		start = timing_now_ns();
+		render_pages(&m.pages, c.jobs);
+		bench_record(&phases, "render_pages", start, timing_now_ns(), md_bytes);
+	}
+
+	for (size_t r = 0; r < c.repeat; ++r) {
+		m.second_stage.count = 0;
+		uint64_t start = timing_now_ns();
+		second_stage_include_header(&m.second_stage, m.mite_source_path);
+		second_stage_codegen(&m.second_stage, &m.pages, &m.templates);
+		bench_record(&phases, "second_stage_codegen", start, timing_now_ns(), m.second_stage.count);
+	}
+
+	int failed = 0;
+	if (c.compile) {
+		write_to_file("site.c", &m.second_stage);
+		for (size_t r = 0; r < c.repeat && !failed; ++r) {
+			uint64_t start = timing_now_ns();
+			failed = execute_line(MITE_CC" -o "SITE_BINARY" site.c");
+			bench_record(&phases, "compile", start, timing_now_ns(), m.second_stage.count);
+		}
+
+		g_timings.enabled = true;
+		uint64_t written = 0;
+		for (size_t r = 0; r < c.repeat && !failed; ++r) {
+			char line[256] = SITE_RUN;
+			append_site_args(line, sizeof(line), c.jobs);
+			uint64_t start = timing_now_ns();
+			failed = execute_line(line);
+			uint64_t end = timing_now_ns();
+
+			// the render and write loop alone, as measured by the site
+			StringBuilder data = {0};
+			SiteTimingRecords records = {0};
+			uint64_t site_start = 0, site_end = 0;
+			load_site_timings(&data, &records, &site_start, &site_end);
+			written = 0;
+			for (size_t i = 0; i < records.count; ++i) written += records.items[i].bytes;
+			bench_record(&phases, "site_run", start, end, written);
+			if (site_end > site_start) bench_record(&phases, "site_render", site_start, site_end, written);
+			free(records.items);
+			free(data.items);
+		}
+		cleanup_site();
+	}
+
+	bench_quiet(false);
+	if (failed) fprintf(stderr, "[error] the generated site failed\n");
+
+	printf("# mite-bench pages=%d layouts=%d includes=%d front_matter=%d code=%d inline=%d jobs=%d repeat=%d\n",
+		(int)c.pages, (int)c.layouts, (int)c.includes, (int)c.front_matter, (int)c.code, (int)c.inline_mix,
+		(int)c.jobs, (int)c.repeat);
+	printf("# phase\tmedian_ms\tmin_ms\tbytes\n");
+	for (size_t i = 0; i < phases.count; ++i) {
+		BenchPhase* p = &phases.items[i];
+		qsort(p->samples_ms, p->count, sizeof(double), compare_double);
+		printf("%s\t%.3f\t%.3f\t%llu\n", p->name, p->samples_ms[p->count / 2], p->samples_ms[0], (unsigned long long)p->bytes);
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		free(md[i].items);
+		free(html[i].items);
+		free(fm[i].items);
+	}
+	free(md);
+	free(html);
+	free(fm);
+	free(code.items);
+	free(chunks.items);
+	free(phases.items);
+	free_mite_generator(&m);
+	return failed ? 1 : 0;
+}
@@ -108,8 +108,32 @@ source: https://github.com/hanion/hanion.github.io
 	#include <unistd.h>
 	#include <signal.h>
 	#include <sys/types.h>
+	#include <sys/wait.h>
+	#include <sys/socket.h>
+	#include <sys/mman.h>
+	#include <sys/resource.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <pthread.h>
+	#include <sys/uio.h>
+	#ifdef SITE_HOST
+		#include <dlfcn.h>
+	#endif
+	#if defined(__linux__)
+		#include <sys/inotify.h>
+		#include <sys/sendfile.h>
+		#include <poll.h>
+	#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+		#define MITE_KQUEUE
+		#include <sys/event.h>
+	#endif
+	#include <fcntl.h>
 #else
+	#include <winsock2.h>
 	#include <windows.h>
+	#ifdef _MSC_VER
+		#pragma comment(lib, "ws2_32")
+	#endif
 #endif
 
 #include <assert.h>
@@ -122,6 +146,14 @@ source: https://github.com/hanion/hanion.github.io
 #include <string.h>
 #include <time.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define MITE_SSE2
+	#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define MITE_NEON
+	#include <arm_neon.h>
+#endif
+
 #define MAX_PATH_LEN 1024
 
 #define da_reserve(da, expected_capacity)                                                          \
@@ -167,7 +199,7 @@ typedef struct {
 	size_t count;
 } StringView;
 
-bool read_entire_file(const char* filepath_cstr, StringBuilder* sb) {
+static inline bool read_entire_file(const char* filepath_cstr, StringBuilder* sb) {
 	if (!filepath_cstr || !sb) return false;
 
 	FILE* f = fopen(filepath_cstr, "rb");
@@ -215,7 +247,7 @@ bool read_entire_file(const char* filepath_cstr, StringBuilder* sb) {
 	return true;
 }
 
-bool write_to_file(const char* filepath_cstr, StringBuilder* sb) {
+static inline bool write_to_file(const char* filepath_cstr, StringBuilder* sb) {
 	if (!filepath_cstr || !sb) return false;
 
 	FILE* f = fopen(filepath_cstr, "wb");
@@ -235,12 +267,258 @@ bool write_to_file(const char* filepath_cstr, StringBuilder* sb) {
 	return true;
 }
 
+// sources at least this big are mapped instead of read, smaller ones are cheaper to read
+#define MITE_MAP_MIN_SIZE (64*1024)
+
+// off while mite keeps running with --watch, --serve or --daemon, an editor that truncates
+// a mapped file in place would end the process with SIGBUS
+static bool g_map_sources = true;
+
+typedef struct {
+	char* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+} MappedFile;
+
+// maps the file read only, data[size] is always 0 so the md parser can read it in place.
+// small files and files that end on a page boundary, where nothing follows the contents, are not mapped
+static inline bool map_file(const char* filepath_cstr, MappedFile* mf) {
+	*mf = (MappedFile){0};
+	if (!g_map_sources) return false;
+#ifndef _WIN32
+	int fd = open(filepath_cstr, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (fstat(fd, &st) != 0 || st.st_size < MITE_MAP_MIN_SIZE || page_size <= 0 || st.st_size % page_size == 0) {
+		close(fd);
+		return false;
+	}
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+	mf->data = data;
+	mf->size = (size_t)st.st_size;
+	return true;
+#else
+	HANDLE file = CreateFileA(filepath_cstr, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < MITE_MAP_MIN_SIZE || size.QuadPart % info.dwPageSize == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!data) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	mf->data = data;
+	mf->size = (size_t)size.QuadPart;
+	mf->file = file;
+	mf->mapping = mapping;
+	return true;
+#endif
+}
+
+static inline void unmap_file(MappedFile* mf) {
+	if (!mf->data) return;
+#ifndef _WIN32
+	munmap(mf->data, mf->size);
+#else
+	UnmapViewOfFile(mf->data);
+	CloseHandle(mf->mapping);
+	CloseHandle(mf->file);
+#endif
+	*mf = (MappedFile){0};
+}
+
+// true if the file holds exactly these bytes
+static inline bool file_equals(const char* filepath_cstr, StringBuilder* sb) {
+	FILE* f = fopen(filepath_cstr, "rb");
+	if (f == NULL) return false;
+
+	bool equal = fseek(f, 0, SEEK_END) == 0 && ftell(f) == (long)sb->count && fseek(f, 0, SEEK_SET) == 0;
+	char buffer[16384];
+	for (size_t offset = 0; equal && offset < sb->count;) {
+		size_t n = fread(buffer, 1, sizeof(buffer), f);
+		if (n == 0 || offset + n > sb->count || memcmp(buffer, sb->items + offset, n) != 0) equal = false;
+		offset += n;
+	}
+	fclose(f);
+	return equal;
+}
+
+typedef enum {
+	WRITE_FAILED = 0,
+	WRITE_UNCHANGED,
+	WRITE_WRITTEN,
+} WriteResult;
+
+// next to the target, unique per process and per worker, so a --daemon host and a manual
+// ./mite writing the same site never share one
+static inline void temp_path(char* out, size_t size, const char* filepath_cstr, size_t unique) {
+#ifndef _WIN32
+	int pid = (int)getpid();
+#else
+	int pid = (int)GetCurrentProcessId();
+#endif
+	snprintf(out, size, "%s.mite-tmp-%d-%d", filepath_cstr, pid, (int)unique);
+}
+
+// the replaced file keeps its mode
+static inline WriteResult replace_file(const char* tmp_path, const char* filepath_cstr) {
+#ifndef _WIN32
+	struct stat st;
+	if (stat(filepath_cstr, &st) == 0) chmod(tmp_path, st.st_mode & 07777);
+	bool renamed = rename(tmp_path, filepath_cstr) == 0;
+#else
+	bool renamed = MoveFileExA(tmp_path, filepath_cstr, MOVEFILE_REPLACE_EXISTING) != 0;
+#endif
+	if (!renamed) {
+		printf("Could not replace file %s: %s\n", filepath_cstr, strerror(errno));
+		remove(tmp_path);
+		return WRITE_FAILED;
+	}
+	return WRITE_WRITTEN;
+}
+
+// leaves files that already hold these bytes alone, so their mtime stays,
+// others are written next to the target and renamed over it, readers never see half a file
+static inline WriteResult write_if_changed(const char* filepath_cstr, StringBuilder* sb, size_t unique) {
+	if (file_equals(filepath_cstr, sb)) return WRITE_UNCHANGED;
+
+	char tmp_path[1100];
+	temp_path(tmp_path, sizeof(tmp_path), filepath_cstr, unique);
+	if (!write_to_file(tmp_path, sb)) return WRITE_FAILED;
+	return replace_file(tmp_path, filepath_cstr);
+}
+
+// FNV-1a
+static inline uint64_t hash_bytes(const void* data, size_t count) {
+	const uint8_t* bytes = data;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < count; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+// monotonic nanoseconds for --timings, the clock is shared with the site process
+static inline uint64_t timing_now_ns(void) {
+#ifndef _WIN32
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#else
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#endif
+}
+
+// ------------------- parallel -------------------------
+#if defined(_MSC_VER)
+	#define atomic_fetch_add_size(ptr, value) (size_t)InterlockedExchangeAdd64((volatile LONG64*)(ptr), (LONG64)(value))
+#elif defined(__TINYC__) && !defined(_WIN32)
+	// the site compiled in process by libtcc, which has no atomic builtins
+	static pthread_mutex_t atomic_fetch_add_lock = PTHREAD_MUTEX_INITIALIZER;
+	static inline size_t atomic_fetch_add_locked(volatile size_t* ptr, size_t value) {
+		pthread_mutex_lock(&atomic_fetch_add_lock);
+		size_t old = *ptr;
+		*ptr += value;
+		pthread_mutex_unlock(&atomic_fetch_add_lock);
+		return old;
+	}
+	#define atomic_fetch_add_size(ptr, value) atomic_fetch_add_locked((volatile size_t*)(ptr), (value))
+#else
+	#define atomic_fetch_add_size(ptr, value) __sync_fetch_and_add((ptr), (value))
+#endif
+
+typedef void (*parallel_func_t)(void* userdata, size_t index, size_t worker);
+
+typedef struct {
+	parallel_func_t func;
+	void* userdata;
+	size_t count;
+	size_t next;
+} ParallelQueue;
+
+typedef struct {
+	ParallelQueue* queue;
+	size_t worker;
+} ParallelWorker;
+
+#ifndef _WIN32
+static inline void* parallel_worker(void* arg) {
+#else
+static inline DWORD WINAPI parallel_worker(LPVOID arg) {
+#endif
+	ParallelWorker* w = arg;
+	for (;;) {
+		size_t index = atomic_fetch_add_size(&w->queue->next, 1);
+		if (index >= w->queue->count) break;
+		w->queue->func(w->queue->userdata, index, w->worker);
+	}
+	return 0;
+}
+
+// calls func for every index in [0, count) from up to `jobs` threads
+// the calling thread is worker 0, worker ids are below `jobs`
+static inline void run_parallel(size_t jobs, size_t count, parallel_func_t func, void* userdata) {
+	if (jobs > count) jobs = count;
+	if (jobs <= 1) {
+		for (size_t i = 0; i < count; ++i) func(userdata, i, 0);
+		return;
+	}
+
+	ParallelQueue queue = { .func = func, .userdata = userdata, .count = count };
+	ParallelWorker* workers = calloc(jobs, sizeof(ParallelWorker));
+#ifndef _WIN32
+	pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+#else
+	HANDLE* threads = calloc(jobs, sizeof(HANDLE));
+#endif
+
+	size_t started = 1;
+	for (size_t i = 0; i < jobs; ++i) workers[i] = (ParallelWorker){ .queue = &queue, .worker = i };
+	for (size_t i = 1; i < jobs; ++i) {
+#ifndef _WIN32
+		if (pthread_create(&threads[i], NULL, parallel_worker, &workers[i]) != 0) break;
+#else
+		threads[i] = CreateThread(NULL, 0, parallel_worker, &workers[i], 0, NULL);
+		if (!threads[i]) break;
+#endif
+		started++;
+	}
+
+	parallel_worker(&workers[0]);
+
+	for (size_t i = 1; i < started; ++i) {
+#ifndef _WIN32
+		pthread_join(threads[i], NULL);
+#else
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+#endif
+	}
+	free(threads);
+	free(workers);
+}
+
 #ifdef SECOND_STAGE
 
-static char temp_sprintf_buf[16] = {0};
-void unusedtemp() { (void)temp_sprintf_buf; }
-#define OUT_HTML(buf, size) da_append_many(out, buf, size);
-#define INT(x) do { if (sprintf(temp_sprintf_buf, "%d", (x))) da_append_cstr(out, temp_sprintf_buf); } while (0);
+#define OUT_HTML(buf, size) site_out_html(out, (buf), (size));
+#define INT(x) do { char int_buf[16]; if (sprintf(int_buf, "%d", (x))) da_append_cstr(out, int_buf); } while (0);
 
 #define RAWSTR2(x) #x
 #define RAWSTR(x) da_append_cstr(out, RAWSTR2(x));
@@ -252,16 +530,24 @@ void unusedtemp() { (void)temp_sprintf_buf; }
 #define CONTENT() render_content_func(out, page);
 #define INCLUDE(mitename) do { SiteTemplate* st = find_template(&global.templates, (mitename)); \
 							if (st && st->is_include) st->function(out, page, render_content_func); } while(0);
+// literal INCLUDE() names are bound to this by the first stage
+#define INCLUDE_TEMPLATE(name) render_template_##name(out, page, render_content_func);
+#define ASSET(path) CSTR(site_asset_url((path)))
 
 typedef struct {
 	const char* key;
 	const char* value;
+	uint64_t hash;
 } SiteMapEntry;
 
 typedef struct {
 	SiteMapEntry* items;
 	size_t count;
 	size_t capacity;
+
+	// open addressing index of the first entry of every key, 0 is empty, built past SITE_MAP_LINEAR_MAX entries
+	uint32_t* table;
+	size_t table_size;
 } SiteMap;
 
 typedef struct {
@@ -277,14 +563,51 @@ typedef struct {
 	const char* output;
 	const char* input;
 	SiteMap data;
+
+	// parsed once from `date` by site_parse_date, again when date is set to another string
+	const char* parsed_date;
+	int64_t timestamp;      // seconds since 1970 utc at the start of the day, 0 when it does not parse
+	int64_t date_key;       // for sort_pages, see parse_date_key
+	int64_t date_key_alt;   // for sort_pages_alt
+	char rfc822[32];        // "Tue, 30 Dec 2025 00:00:00 +0000", empty when it does not parse
+	char iso8601[24];       // "2025-12-30T00:00:00Z"
+
+	// PAGINATE(), every output lists `per_page` items of `paginate` from `page_first` on
+	struct SitePages* paginate;
+	size_t per_page;
+	size_t page_number; // 1 based
+	size_t page_count;
+	size_t page_first;
+	const char** page_urls;
 } SitePage;
 
-typedef struct {
+typedef struct SitePages {
 	SitePage** items;
 	size_t count;
 	size_t capacity;
+
+	// set by sort_pages and sort_pages_alt, a repeated sort of the same pages is free
+	int sorted_by;
+	size_t sorted_count;
+	bool hoisted; // sorted by prepare_global_state, sorts while rendering do nothing
 } SitePages;
 
+typedef struct {
+	const char* name;
+	SitePages* pages; // newest first, does not move when more tags are added
+} SiteTag;
+
+typedef struct {
+	SiteTag* items;
+	size_t count;
+	size_t capacity;
+
+	// open addressing index on the name, slots hold the item index + 1
+	uint32_t* table;
+	size_t table_size;
+	bool indexed; // by site_index_tags, unknown tags are not added anymore
+} SiteTags;
+
 
 typedef void (*render_content_func_t) (StringBuilder* out, SitePage* page);
 typedef void (*render_template_func_t)(StringBuilder* out, SitePage* page, render_content_func_t render_content_func);
@@ -299,6 +622,10 @@ typedef struct {
 	SiteTemplate* items;
 	size_t count;
 	size_t capacity;
+
+	// open addressing index on the name, built by site_templates_index
+	SiteTemplate** table;
+	size_t table_size;
 } SiteTemplates;
 
 
@@ -309,6 +636,7 @@ typedef struct {
 	const char* favicon_path;
 	SitePages pages;
 	SiteTemplates templates;
+	SiteTags tags; // every page by the words of its tags
 
 	// custom data
 	SitePages posts;
@@ -317,9 +645,12 @@ typedef struct {
 	SiteMap data;
 } SiteGlobal;
 
+// defined by the generated site
+extern SiteGlobal global;
 
 
-SitePage* find_page(SitePages* pages, const char* input_file) {
+
+static inline SitePage* find_page(SitePages* pages, const char* input_file) {
 	if (!input_file) return NULL;
 	for (size_t i = 0; i < pages->count; ++i) {
 		if (!pages->items[i]) continue;
@@ -328,1200 +659,5522 @@ SitePage* find_page(SitePages* pages, const char* input_file) {
 	}
 	return NULL;
 }
-SiteTemplate* find_template(SiteTemplates* templates, const char* name) {
-	if (!name) return NULL;
+static inline void site_templates_index(SiteTemplates* templates) {
+	free(templates->table);
+	templates->table_size = 16;
+	while (templates->table_size < templates->count * 2) templates->table_size *= 2;
+	templates->table = calloc(templates->table_size, sizeof(SiteTemplate*));
+
+	size_t mask = templates->table_size - 1;
 	for (size_t i = 0; i < templates->count; ++i) {
-		if (!templates->items[i].name) continue;
-		if (0 == strcmp(templates->items[i].name, name)) return &templates->items[i];
+		SiteTemplate* st = &templates->items[i];
+		if (!st->name) continue;
+		size_t slot = hash_bytes(st->name, strlen(st->name)) & mask;
+		while (templates->table[slot]) slot = (slot + 1) & mask;
+		templates->table[slot] = st;
 	}
-	fprintf(stderr,"[error] template '%s' not found!\n", name);
-	exit(1);
-	return NULL;
-}
-
-SitePage* site_page_new() {
-	return calloc(1, sizeof(SitePage));
 }
-SitePage* site_page_new_tdu(const char* title, const char* desc, const char* url) {
-	SitePage* p = site_page_new();
-	p->title = title;
-	p->description = desc;
-	p->url = url;
-	p->layout = DEFAULT_PAGE_LAYOUT;
-	return p;
-}
-
-#define ADD_PROJECT(t, d, u) da_append(&global.projects, site_page_new_tdu((t),(d),(u)));
-#define ADD_SOCIAL(t, u)     da_append(&global.socials,  site_page_new_tdu((t),NULL,(u)));
-
-#define ADD_TO_GLOBAL_POSTS(page) da_append(&global.posts, (page));
-#define SET_POST()    da_append(&global.posts,    (page));
-#define SET_PROJECT() da_append(&global.projects, (page));
-
-
 
-void site_map_set(SiteMap* map, const char* key, const char* value) {
-	if (map->count == map->capacity) {
-		map->capacity = map->capacity ? map->capacity * 2 : 8;
-		map->items = realloc(map->items, map->capacity * sizeof(SiteMapEntry));
-	}
-	map->items[map->count].key = key;
-	map->items[map->count].value = value;
-	map->count++;
-}
-const char* site_map_get(SiteMap* map, const char* key) {
-	for (size_t i = 0; i < map->count; ++i) {
-		if (strcmp(map->items[i].key, key) == 0) {
-			return map->items[i].value;
+static inline SiteTemplate* find_template(SiteTemplates* templates, const char* name) {
+	if (!name) return NULL;
+	if (templates->table) {
+		size_t mask = templates->table_size - 1;
+		for (size_t slot = hash_bytes(name, strlen(name)) & mask; templates->table[slot]; slot = (slot + 1) & mask) {
+			if (0 == strcmp(templates->table[slot]->name, name)) return templates->table[slot];
+		}
+	} else {
+		for (size_t i = 0; i < templates->count; ++i) {
+			if (!templates->items[i].name) continue;
+			if (0 == strcmp(templates->items[i].name, name)) return &templates->items[i];
 		}
 	}
+	fprintf(stderr,"[error] template '%s' not found!\n", name);
+	exit(1);
 	return NULL;
 }
 
-bool site_map_has(SiteMap* map, const char* key) {
-	for (size_t i = 0; i < map->count; ++i) {
-		if (strcmp(map->items[i].key, key) == 0) return true;
-	}
-	return false;
-}
-
-bool site_map_equals(SiteMap* map, const char* key, const char* value) {
-	for (size_t i = 0; i < map->count; ++i) {
-		if (strcmp(map->items[i].key, key) == 0) {
-			return strcmp(map->items[i].value, value) == 0;
-		}
+// --fingerprint, the hashed copy of an asset by its path from the site root
+typedef struct {
+	const char* path;
+	const char* url;
+} SiteAsset;
+
+// defined by the generated site, sorted by path
+extern const SiteAsset site_assets[];
+extern const size_t site_assets_count;
+
+static inline const char* site_asset_url(const char* path) {
+	if (!path) return NULL;
+	const char* key = path;
+	while (key[0] == '.' && key[1] == '/') key += 2;
+	while (key[0] == '/') key++;
+	size_t lo = 0, hi = site_assets_count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int c = strcmp(key, site_assets[mid].path);
+		if (c == 0) return site_assets[mid].url;
+		if (c < 0) hi = mid;
+		else lo = mid + 1;
 	}
-	return false;
+	// not fingerprinted, links the asset itself
+	return path;
 }
 
+// ------------------- arena ----------------------------
+// every thread of the site allocates from two arenas of its own: the site arena keeps
+// pages and their data for the whole run, the scratch arena backs template helpers
+// like format_rfc822 and is reset after every page is written. nothing is freed one by one
+#if defined(__TINYC__)
+	// no thread local storage, helpers allocate from the heap
+	#define SITE_NO_ARENA
+#elif defined(_MSC_VER)
+	#define SITE_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+	#define SITE_THREAD_LOCAL _Thread_local
+#else
+	#define SITE_THREAD_LOCAL __thread
+#endif
 
+#define SITE_ARENA_BLOCK (64*1024)
+#define SITE_ARENA_ALIGN 16
 
-#define DATA_SET(obj, key, value) site_map_set(&((obj)->data), (key), (value));
-#define DATA_GET(obj, key)        site_map_get(&((obj)->data), (key))
-#define DATA_HAS(obj, key)        site_map_has(&((obj)->data), (key))
-#define DATA_IS(obj, key, value)  site_map_equals(&((obj)->data), (key), (value))
+typedef struct SiteArenaBlock {
+	struct SiteArenaBlock* next;
+	size_t size;
+	size_t used;
+	size_t pad; // keeps data as aligned as malloc
+	char data[];
+} SiteArenaBlock;
 
-#define GLOBAL_SET(key, value) DATA_SET(&global, key, value)
-#define GLOBAL_GET(key)        DATA_GET(&global, key)
-#define GLOBAL_HAS(key)        DATA_HAS(&global, key)
-#define GLOBAL_IS(key, value)  DATA_IS (&global, key, value)
+typedef struct {
+	SiteArenaBlock* first;
+	SiteArenaBlock* current; // blocks past it are empty after a reset
+} SiteArena;
 
-#define PAGE_SET(key, value) DATA_SET(page, key, value)
-#define PAGE_GET(key)        DATA_GET(page, key)
-#define PAGE_HAS(key)        DATA_HAS(page, key)
-#define PAGE_IS(key, value)  DATA_IS (page, key, value)
+static inline size_t site_arena_align(size_t size) {
+	return (size + SITE_ARENA_ALIGN - 1) & ~(size_t)(SITE_ARENA_ALIGN - 1);
+}
 
-void sort_pages(SitePages* sp) {
-	for (size_t i = 0; i < sp->count; ++i) {
-		for (size_t j = i + 1; j < sp->count; ++j) {
-			if (!sp->items[i] || !sp->items[j]) continue;
-			if (!sp->items[i]->date || !sp->items[j]->date) continue;
-			if (strcmp(sp->items[i]->date, sp->items[j]->date) < 0) {
-				SitePage* tmp = sp->items[i];
-				sp->items[i] = sp->items[j];
-				sp->items[j] = tmp;
-			}
+// zeroed like calloc
+static inline void* site_arena_alloc(SiteArena* arena, size_t size) {
+	size = site_arena_align(size ? size : 1);
+	SiteArenaBlock* b = arena->current;
+	while (b && b->used + size > b->size) {
+		b = b->next;
+		if (b) arena->current = b;
+	}
+	if (!b) {
+		size_t block = size > SITE_ARENA_BLOCK ? size : SITE_ARENA_BLOCK;
+		b = malloc(sizeof(SiteArenaBlock) + block);
+		if (!b) return NULL;
+		b->next = NULL;
+		b->size = block;
+		b->used = 0;
+		if (arena->current) {
+			b->next = arena->current->next;
+			arena->current->next = b;
+		} else {
+			arena->first = b;
 		}
+		arena->current = b;
 	}
+	void* result = b->data + b->used;
+	b->used += size;
+	memset(result, 0, size);
+	return result;
 }
 
-
-static int compare_ddmmyyyy(const char* a, const char* b) {
-	if (!a || !b) return 0;
-	int da, ma, ya;
-	int db, mb, yb;
-	if (sscanf(a, "%d/%d/%d", &da, &ma, &ya) != 3) return 0;
-	if (sscanf(b, "%d/%d/%d", &db, &mb, &yb) != 3) return 0;
-	if (ya != yb) return (ya > yb) ? -1 : 1;
-	if (ma != mb) return (ma > mb) ? -1 : 1;
-	if (da != db) return (da > db) ? -1 : 1;
-	return 0;
-}
-
-void sort_pages_alt(SitePages* sp) {
-	for (size_t i = 0; i < sp->count; ++i) {
-		for (size_t j = i + 1; j < sp->count; ++j) {
-			if (!sp->items[i] || !sp->items[j]) continue;
-			if (!sp->items[i]->date || !sp->items[j]->date) continue;
-			if (compare_ddmmyyyy(sp->items[i]->date, sp->items[j]->date) > 0) {
-				SitePage* tmp = sp->items[i];
-				sp->items[i] = sp->items[j];
-				sp->items[j] = tmp;
-			}
-		}
+// the last allocation grows in place when it fits
+static inline void* site_arena_grow(SiteArena* arena, void* ptr, size_t old_size, size_t new_size) {
+	SiteArenaBlock* b = arena->current;
+	if (ptr && b && (char*)ptr + site_arena_align(old_size) == b->data + b->used
+			&& (char*)ptr - b->data + site_arena_align(new_size) <= b->size) {
+		b->used = (char*)ptr - b->data + site_arena_align(new_size);
+		memset((char*)ptr + old_size, 0, new_size - old_size);
+		return ptr;
 	}
+	void* result = site_arena_alloc(arena, new_size);
+	if (result && ptr) memcpy(result, ptr, old_size);
+	return result;
 }
 
-char* format_rfc822(const char *ymd) {
-	char* out = calloc(64, sizeof(char));
-	struct tm t = {0};
-	sscanf(ymd, "%d-%d-%d", &t.tm_year, &t.tm_mon, &t.tm_mday);
-	t.tm_year -= 1900;
-	t.tm_mon  -= 1;
-	t.tm_hour = 0;
-	t.tm_min = 0;
-	t.tm_sec = 0;
-
-	mktime(&t);
-
-	strftime(out, 64, "%a, %d %b %Y %H:%M:%S +0000", &t);
-	return out;
+static inline void site_arena_reset(SiteArena* arena) {
+	for (SiteArenaBlock* b = arena->first; b; b = b->next) b->used = 0;
+	arena->current = arena->first;
 }
 
-
-
-
-
-#else // #ifdef SECOND_STAGE
-
-
-
-
-
-bool file_exists(const char* path) {
-#ifndef _WIN32
-	return access(path, F_OK) == 0;
+#if defined(SITE_NO_ARENA)
+#elif defined(SITE_SHARED_ARENAS)
+// the units of --split use the arenas defined by their global unit
+extern SITE_THREAD_LOCAL SiteArena site_arena;
+extern SITE_THREAD_LOCAL SiteArena site_scratch_arena;
+extern SITE_THREAD_LOCAL bool site_rendering;
 #else
-	DWORD attrs = GetFileAttributesA(path);
-	return (attrs != INVALID_FILE_ATTRIBUTES) && !(attrs & FILE_ATTRIBUTE_DIRECTORY);
+static SITE_THREAD_LOCAL SiteArena site_arena;
+static SITE_THREAD_LOCAL SiteArena site_scratch_arena;
+static SITE_THREAD_LOCAL bool site_rendering; // scratch memory only lives until the page is written
 #endif
-}
 
-static inline int execute_line(const char* line) {
-#ifndef _WIN32
-	return system(line);
+static inline void* site_alloc(size_t size) {
+#ifndef SITE_NO_ARENA
+	return site_arena_alloc(&site_arena, size);
 #else
-	#define CMD_LINE_MAX 2000
-	char full_command[CMD_LINE_MAX + 16];
-	snprintf(full_command, sizeof(full_command), "cmd /C \"%s\"", line);
-	return system(full_command);
+	return calloc(1, size ? size : 1);
 #endif
 }
 
-
-const char* get_mite_binary_path() {
-	if (file_exists("./mite")) {
-		return "./mite";
-	} else if (file_exists("/usr/bin/mite")) {
-		return "/usr/bin/mite";
-	}
-	return NULL;
-}
-
-
-#ifndef _WIN32
-static pid_t g_watcher_pid = -1;
-#else
-static HANDLE g_watcher_proc = NULL;
-#endif
-
-void start_watcher() {
-#ifndef _WIN32
-	g_watcher_pid = fork();
-	if (g_watcher_pid == 0) {
-		execl(get_mite_binary_path(), "mite", "--watch", NULL);
-		_exit(1);
-	}
+static inline void* site_grow(void* ptr, size_t old_size, size_t new_size) {
+#ifndef SITE_NO_ARENA
+	return site_arena_grow(&site_arena, ptr, old_size, new_size);
 #else
-	PROCESS_INFORMATION pi;
-	STARTUPINFO si = {0};
-	si.cb = sizeof(si);
-
-	if (CreateProcess(NULL, "mite.exe --watch", NULL, NULL, FALSE,
-				   CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-		g_watcher_proc = pi.hProcess;  // store HANDLE
-		CloseHandle(pi.hThread);       // thread handle not needed
-	}
+	(void)old_size;
+	return realloc(ptr, new_size);
 #endif
 }
 
-void watch() {
-#ifndef _WIN32
-	execl(get_mite_binary_path(), "mite", "--incremental", NULL);
-	sleep(1);
+// memory from site_alloc is never freed on its own
+static inline void site_free(void* ptr) {
+#ifdef SITE_NO_ARENA
+	free(ptr);
 #else
-	execute_line("mite.exe --incremental");
-	Sleep(1000);
+	(void)ptr;
 #endif
 }
 
-void stop_watcher() {
-#ifndef _WIN32
-	if (g_watcher_pid > 0) {
-		kill(g_watcher_pid, SIGTERM);
-		g_watcher_pid = -1;
-	}
+// for the output of template helpers, valid until the page is written,
+// outside of rendering, in the front matter, it is never reset
+static inline void* site_scratch(size_t size) {
+#ifndef SITE_NO_ARENA
+	return site_rendering ? site_arena_alloc(&site_scratch_arena, size) : site_alloc(size);
 #else
-	if (g_watcher_proc) {
-		TerminateProcess(g_watcher_proc, 0);
-		CloseHandle(g_watcher_proc);
-		g_watcher_proc = NULL;
-	}
+	return calloc(1, size ? size : 1);
 #endif
 }
 
-static inline int build_and_run_site() {
-#ifndef _WIN32
-	return execute_line("cc -o site site.c && ./site");
-#else
-	return execute_line("gcc -o site.exe site.c && site.exe");
+static inline void site_scratch_begin(void) {
+#ifndef SITE_NO_ARENA
+	site_rendering = true;
 #endif
 }
 
-static inline void cleanup_site() {
-#ifndef _WIN32
-	remove("site.c");
-	remove("site");
-#else
-	DeleteFileA("site.c");
-	DeleteFileA("site.exe");
+static inline void site_scratch_end(void) {
+#ifndef SITE_NO_ARENA
+	site_rendering = false;
+	site_arena_reset(&site_scratch_arena);
 #endif
 }
 
+// ------------------- stream ---------------------------
+// with --stream, pages whose last output was at least SITE_STREAM_MIN bytes are written while
+// they render. OUT_HTML() keeps a reference to the static chunk instead of copying it, the rest
+// is staged in `out`, and both go out with writev every SITE_STREAM_REFS chunks or
+// SITE_STREAM_STAGE staged bytes. the output is compared to the file it replaces on the way,
+// an unchanged page is still never written
+#if defined(SITE_NO_ARENA) || defined(_WIN32)
+	#define SITE_NO_STREAM
+#endif
 
+#define SITE_STREAM_MIN (64*1024)
+#define SITE_STREAM_STAGE (16*1024)
+#define SITE_STREAM_REFS 64
+#define SITE_STREAM_REF_MIN 64 // shorter chunks are cheaper to copy
 
+#ifndef SITE_NO_STREAM
+typedef struct {
+	const char* data;
+	size_t size;
+	size_t staged; // bytes of the stage that come before it
+} SiteStreamRef;
 
-// ------------------- md2html --------------------------
 typedef struct {
-	StringBuilder* out;
-	const char* cursor;
-	bool in_paragraph;
-	bool in_list;
-} MdRenderer;
+	StringBuilder* out; // the stage, OUT_HTML() into other builders copies as usual
+	SiteStreamRef refs[SITE_STREAM_REFS];
+	size_t ref_count;
+	const char* path;
+	char tmp_path[1100];
+	FILE* old;          // the file it replaces, while the output still equals it
+	int fd;             // the new file once they differ
+	size_t total;
+	bool failed;
+} SiteStream;
+
+#ifdef SITE_SHARED_ARENAS
+extern SITE_THREAD_LOCAL SiteStream* site_stream;
+#else
+static SITE_THREAD_LOCAL SiteStream* site_stream; // of the page this thread renders
+#endif
 
-void da_append_escape_html(StringBuilder* out, const char* in, size_t count) {
-	for (size_t i = 0; i < count; ++i) {
-		switch ((unsigned char)in[i]) {
-			case '<':  da_append_cstr(out, "&lt;");   break;
-			case '>':  da_append_cstr(out, "&gt;");   break;
-			case '&':  da_append_cstr(out, "&amp;");  break;
-			case '\'': da_append_cstr(out, "&#39;");  break;
-			case '"':  da_append_cstr(out, "&quot;"); break;
-			default:   da_append(out, in[i]);         break;
-		}
+static inline bool site_write_all(int fd, const char* data, size_t size) {
+	while (size > 0) {
+		ssize_t n = write(fd, data, size);
+		if (n <= 0) return false;
+		data += n;
+		size -= (size_t)n;
 	}
+	return true;
 }
 
-const char* search_str_until_newline(const char* haystack, const char* needle) {
-	if (!haystack) return NULL;
-	if (!*needle) return haystack;
-
-	const char* hay = haystack;
-	const char* ndl = needle;
+// opens the new file, starting with the part of the old one the output matched
+static inline bool site_stream_diverge(SiteStream* s) {
+	s->fd = open(s->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (s->fd < 0) return false;
+	if (!s->old) return true;
+
+	char buffer[16384];
+	bool ok = fseek(s->old, 0, SEEK_SET) == 0;
+	for (size_t left = s->total; ok && left > 0;) {
+		size_t n = fread(buffer, 1, left < sizeof(buffer) ? left : sizeof(buffer), s->old);
+		ok = n > 0 && site_write_all(s->fd, buffer, n);
+		left -= n;
+	}
+	fclose(s->old);
+	s->old = NULL;
+	return ok;
+}
 
-	while (*hay && *hay != '\n') {
-		const char* h_sub = hay;
-		const char* n_sub = ndl;
+static inline bool site_stream_matches(SiteStream* s, const char* data, size_t size) {
+	char buffer[16384];
+	while (size > 0) {
+		size_t n = size < sizeof(buffer) ? size : sizeof(buffer);
+		if (fread(buffer, 1, n, s->old) != n || memcmp(buffer, data, n) != 0) return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
 
-		while (*n_sub) {
-			if (*h_sub == '\n' || *h_sub == '\0') break;
-			if (*h_sub != *n_sub) break;
-			h_sub++;
-			n_sub++;
+static inline void site_stream_flush(SiteStream* s) {
+	struct iovec iov[SITE_STREAM_REFS * 2 + 1];
+	int count = 0;
+	size_t staged = 0;
+	for (size_t i = 0; i < s->ref_count; ++i) {
+		SiteStreamRef* r = &s->refs[i];
+		if (r->staged > staged) iov[count++] = (struct iovec){ .iov_base = s->out->items + staged, .iov_len = r->staged - staged };
+		iov[count++] = (struct iovec){ .iov_base = (void*)r->data, .iov_len = r->size };
+		staged = r->staged;
+	}
+	if (s->out->count > staged) iov[count++] = (struct iovec){ .iov_base = s->out->items + staged, .iov_len = s->out->count - staged };
+
+	int first = 0;
+	while (s->old && first < count) {
+		if (!site_stream_matches(s, iov[first].iov_base, iov[first].iov_len)) {
+			if (!site_stream_diverge(s)) s->failed = true;
+			break;
 		}
-		if (*n_sub == '\0') return hay;
+		s->total += iov[first++].iov_len;
+	}
+	while (!s->failed && first < count) {
+		ssize_t n = writev(s->fd, iov + first, count - first);
+		if (n <= 0) {
+			s->failed = true;
+			break;
+		}
+		s->total += (size_t)n;
+		while (first < count && (size_t)n >= iov[first].iov_len) n -= iov[first++].iov_len;
+		if (first < count) {
+			iov[first].iov_base = (char*)iov[first].iov_base + n;
+			iov[first].iov_len -= (size_t)n;
+		}
+	}
+	s->out->count = 0;
+	s->ref_count = 0;
+}
 
-		hay++;
+static inline void site_stream_begin(SiteStream* s, const char* path, StringBuilder* out, size_t unique) {
+	*s = (SiteStream){ .out = out, .path = path, .fd = -1 };
+	temp_path(s->tmp_path, sizeof(s->tmp_path), path, unique);
+	s->old = fopen(path, "rb");
+	if (!s->old && !site_stream_diverge(s)) s->failed = true;
+	site_stream = s;
+}
+
+static inline WriteResult site_stream_end(SiteStream* s) {
+	site_stream_flush(s);
+	site_stream = NULL;
+	// an old file that goes on differs too
+	bool unchanged = s->old && !s->failed && fgetc(s->old) == EOF;
+	if (!unchanged && !s->failed && s->fd < 0 && !site_stream_diverge(s)) s->failed = true;
+	if (s->old) fclose(s->old);
+	if (s->fd >= 0 && close(s->fd) != 0) s->failed = true;
+	if (unchanged) return WRITE_UNCHANGED;
+	if (s->failed) {
+		printf("Could not write file %s: %s\n", s->path, strerror(errno));
+		remove(s->tmp_path);
+		return WRITE_FAILED;
 	}
+	return replace_file(s->tmp_path, s->path);
+}
+#endif // SITE_NO_STREAM
+
+// the static html chunks of templates and pages, see `--stream`
+static inline void site_out_html(StringBuilder* out, const char* data, size_t size) {
+#ifndef SITE_NO_STREAM
+	SiteStream* s = site_stream;
+	if (s && out == s->out) {
+		if (size >= SITE_STREAM_REF_MIN) s->refs[s->ref_count++] = (SiteStreamRef){ .data = data, .size = size, .staged = out->count };
+		else da_append_many(out, data, size);
+		if (s->ref_count == SITE_STREAM_REFS || out->count >= SITE_STREAM_STAGE) site_stream_flush(s);
+		return;
+	}
+#endif
+	da_append_many(out, data, size);
+}
 
-	return NULL;
+static inline SitePage* site_page_new() {
+	return site_alloc(sizeof(SitePage));
+}
+static inline SitePage* site_page_new_tdu(const char* title, const char* desc, const char* url) {
+	SitePage* p = site_page_new();
+	p->title = title;
+	p->description = desc;
+	p->url = url;
+	p->layout = DEFAULT_PAGE_LAYOUT;
+	return p;
 }
 
-size_t sv_strstr(StringView haystack, StringView needle) {
-	if (needle.count == 0) return 0;
-	if (haystack.count < needle.count) return haystack.count;
+// ------------------- compress -------------------------
+// --compress writes a .gz (and with MITE_USE_BROTLI a .br) next to every page,
+// from the output buffer while it is still in memory
+// gzip is a small deflate encoder: lz77 over hash chains and the fixed huffman codes
+#ifdef MITE_USE_BROTLI
+	#include <brotli/encode.h>
+	#define MITE_BROTLI_QUALITY 9
+#endif
 
-	for (size_t i = 0; i <= haystack.count - needle.count; ++i) {
-		if (memcmp(haystack.items + i, needle.items, needle.count) == 0) {
-			return i;
-		}
+#define GZIP_WINDOW    32768
+#define GZIP_HASH_BITS 15
+#define GZIP_MAX_CHAIN 48
+#define GZIP_MAX_MATCH 258
+
+// state of one worker, the counts are summed up after rendering
+typedef struct {
+	StringBuilder gz;
+	StringBuilder br;
+	int32_t* head;  // last position of every hash
+	int32_t* prev;  // previous position with the same hash, by position in the window
+	size_t files;
+	size_t input;
+	size_t gz_bytes;
+	size_t br_bytes;
+} SiteCompressor;
+
+typedef struct {
+	StringBuilder* out;
+	uint64_t bits;
+	int count;
+} BitWriter;
+
+static uint32_t gzip_crc_table[256];
+
+// before the workers start
+static inline void gzip_init(void) {
+	for (uint32_t i = 0; i < 256; ++i) {
+		uint32_t c = i;
+		for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		gzip_crc_table[i] = c;
 	}
-	return haystack.count;
 }
 
-bool starts_with(const char* line, const char* prefix) {
-	return strncmp(line, prefix, strlen(prefix)) == 0;
+static inline uint32_t gzip_crc32(const uint8_t* data, size_t count) {
+	uint32_t crc = 0xffffffffu;
+	for (size_t i = 0; i < count; ++i) crc = gzip_crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return crc ^ 0xffffffffu;
 }
-bool word_starts_with(const char* line, const char* prefix) {
-	size_t len = strlen(prefix);
-	return strncmp(line, prefix, len) == 0 && (*(line+len) != ' ');
+
+static inline void bits_put(BitWriter* w, uint32_t value, int count) {
+	w->bits |= (uint64_t)value << w->count;
+	w->count += count;
+	while (w->count >= 8) {
+		da_append(w->out, (char)(w->bits & 0xff));
+		w->bits >>= 8;
+		w->count -= 8;
+	}
 }
-const char* word_ends_with(const char* line, const char* prefix) {
-	const char* end = search_str_until_newline(line, prefix);
-	if (end && (*(end-1) == ' ')) return NULL;
-	return end;
+
+// huffman codes are sent starting from their most significant bit
+static inline void bits_put_code(BitWriter* w, uint32_t code, int count) {
+	uint32_t reversed = 0;
+	for (int i = 0; i < count; ++i) {
+		reversed = (reversed << 1) | (code & 1);
+		code >>= 1;
+	}
+	bits_put(w, reversed, count);
 }
 
-void parse_inline(MdRenderer* r, const char* line) {
+static inline void deflate_symbol(BitWriter* w, int symbol) {
+	if      (symbol < 144) bits_put_code(w, 0x30 + symbol, 8);
+	else if (symbol < 256) bits_put_code(w, 0x190 + symbol - 144, 9);
+	else if (symbol < 280) bits_put_code(w, symbol - 256, 7);
+	else                   bits_put_code(w, 0xc0 + symbol - 280, 8);
+}
 
-#define PARSE_INLINE_TAG(start, end, html_start, html_end)             \
-	else if (word_starts_with(p, start)) {                             \
-		size_t start_len = sizeof(start) - 1;                          \
-		size_t end_len   = sizeof(end) - 1;                            \
-		const char* tag_end = word_ends_with(p + start_len, end);      \
-		if (tag_end) {                                                 \
-			p += start_len;                                            \
-			da_append_cstr(r->out, html_start);                        \
-			da_append_escape_html(r->out, p, tag_end - p);             \
-			da_append_cstr(r->out, html_end);                          \
-			p = tag_end + end_len;                                     \
-			continue;                                                  \
-		}                                                              \
+static const uint16_t deflate_length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t deflate_length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t deflate_distance_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+	1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t deflate_distance_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static inline void deflate_match(BitWriter* w, size_t length, size_t distance) {
+	int l = 28;
+	while (deflate_length_base[l] > length) l--;
+	deflate_symbol(w, 257 + l);
+	bits_put(w, (uint32_t)(length - deflate_length_base[l]), deflate_length_extra[l]);
+	int d = 29;
+	while (deflate_distance_base[d] > distance) d--;
+	bits_put_code(w, d, 5);
+	bits_put(w, (uint32_t)(distance - deflate_distance_base[d]), deflate_distance_extra[d]);
+}
+
+static inline uint32_t gzip_hash(const uint8_t* p) {
+	uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+	return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+static inline void gzip_insert(SiteCompressor* c, const uint8_t* data, size_t i) {
+	uint32_t h = gzip_hash(data + i);
+	c->prev[i & (GZIP_WINDOW - 1)] = c->head[h];
+	c->head[h] = (int32_t)i;
+}
+
+// a gzip member with a zero mtime, the same input always gives the same bytes
+static inline void gzip_compress(SiteCompressor* c, const char* input, size_t count) {
+	if (!c->head) {
+		c->head = malloc(sizeof(int32_t) << GZIP_HASH_BITS);
+		c->prev = malloc(sizeof(int32_t) * GZIP_WINDOW);
 	}
+	memset(c->head, 0xff, sizeof(int32_t) << GZIP_HASH_BITS);
 
-	const char* p = line;
-	while (*p && (*p != '\r') && (*p != '\n')) {
-		// double space line break
-		if (starts_with(p, "  \n") || starts_with(p, "  \r\n")) {
-			da_append_cstr(r->out, "<br>\n");
-			p += 3;
-			break;
-		}
+	const uint8_t* data = (const uint8_t*)input;
+	c->gz.count = 0;
+	da_reserve(&c->gz, count / 3 + 64);
+	static const char header[10] = { 0x1f, (char)0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+	da_append_many(&c->gz, header, sizeof(header));
 
-		if (false) {}
-		PARSE_INLINE_TAG("***", "***", "<strong><i>", "</i></strong>")
-		PARSE_INLINE_TAG("**_", "_**", "<strong><i>", "</i></strong>")
-		PARSE_INLINE_TAG("_**", "**_", "<strong><i>", "</i></strong>")
-		PARSE_INLINE_TAG("**", "**", "<strong>", "</strong>")
-		PARSE_INLINE_TAG("*", "*", "<i>", "</i>")
-		PARSE_INLINE_TAG("_", "_", "<i>", "</i>")
-		PARSE_INLINE_TAG("`", "`", "<code>", "</code>")
-		PARSE_INLINE_TAG("\\(", "\\)", "\\(", "\\)")
-		else if (*p == '[') {
-			const char* end_text = search_str_until_newline(p, "]");
-			if (!end_text || end_text[1] != '(') {
-				da_append_escape_html(r->out, p, 1);
-				++p;
-				continue;
+	BitWriter w = { .out = &c->gz };
+	bits_put(&w, 1, 1); // last block
+	bits_put(&w, 1, 2); // fixed huffman codes
+
+	size_t i = 0;
+	while (i < count) {
+		size_t best = 0, distance = 0;
+		if (i + 3 <= count) {
+			size_t limit = count - i < GZIP_MAX_MATCH ? count - i : GZIP_MAX_MATCH;
+			int32_t candidate = c->head[gzip_hash(data + i)];
+			for (int chain = GZIP_MAX_CHAIN; candidate >= 0 && i - (size_t)candidate <= GZIP_WINDOW && chain > 0; --chain) {
+				const uint8_t* a = data + candidate;
+				const uint8_t* b = data + i;
+				if (a[best] == b[best]) {
+					size_t len = 0;
+					while (len < limit && a[len] == b[len]) len++;
+					if (len > best) {
+						best = len;
+						distance = i - (size_t)candidate;
+						if (len == limit) break;
+					}
+				}
+				int32_t next = c->prev[candidate & (GZIP_WINDOW - 1)];
+				if (next >= candidate) break; // the slot was reused by a newer position
+				candidate = next;
 			}
-			const char* end_url = search_str_until_newline(end_text + 2, ")");
-			if (!end_url) break;
-			da_append_cstr(r->out, "<a href=\"");
-			da_append_many(r->out, end_text + 2, end_url - (end_text + 2));
-			da_append_cstr(r->out, "\">");
-			da_append_escape_html(r->out, p + 1, end_text - (p + 1));
-			da_append_cstr(r->out, "</a>");
-			p = end_url + 1;
-			continue;
+			gzip_insert(c, data, i);
 		}
-		// figure
-		else if (starts_with(p, "![")) {
-			const char* end_text = search_str_until_newline(p+2, "]");
-			if (!end_text || end_text[1] != '(') {
-				da_append_many(r->out, p, 2);
-				p += 2;
-				continue;
-			}
-			const char* end_url = search_str_until_newline(end_text + 2, ")");
-			if (!end_url) break;
+		if (best >= 3) {
+			deflate_match(&w, best, distance);
+			for (size_t k = i + 1; k < i + best && k + 3 <= count; ++k) gzip_insert(c, data, k);
+			i += best;
+		} else {
+			deflate_symbol(&w, data[i]);
+			i++;
+		}
+	}
+	deflate_symbol(&w, 256);
+	if (w.count) bits_put(&w, 0, 8 - w.count);
+
+	uint32_t crc = gzip_crc32(data, count);
+	uint32_t size = (uint32_t)count;
+	char trailer[8];
+	for (int k = 0; k < 4; ++k) {
+		trailer[k] = (char)(crc >> (8 * k));
+		trailer[4 + k] = (char)(size >> (8 * k));
+	}
+	da_append_many(&c->gz, trailer, sizeof(trailer));
+}
 
-			const char* format = end_url;
-			while (format > end_text && *(format-1) != '.') --format;
+static inline bool site_file_exists(const char* path) {
+#ifndef _WIN32
+	return access(path, F_OK) == 0;
+#else
+	return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+#endif
+}
 
-			const size_t format_len = end_url - format;
-			bool video = false;
-			if (format_len == 3 && 0 == strncmp(format, "mp4",  3)) video = true;
-			if (format_len == 4 && 0 == strncmp(format, "webm", 4)) video = true;
+// an unchanged page keeps the sidecars it already has
+static inline void site_write_sidecars(SiteCompressor* c, const char* path, StringBuilder* html, WriteResult result, size_t worker) {
+	char sidecar[MAX_PATH_LEN];
+	snprintf(sidecar, sizeof(sidecar), "%s.gz", path);
+	bool counted = false;
+	if (result != WRITE_UNCHANGED || !site_file_exists(sidecar)) {
+		gzip_compress(c, html->items, html->count);
+		write_if_changed(sidecar, &c->gz, worker);
+		c->gz_bytes += c->gz.count;
+		counted = true;
+	}
+#ifdef MITE_USE_BROTLI
+	snprintf(sidecar, sizeof(sidecar), "%s.br", path);
+	if (result != WRITE_UNCHANGED || !site_file_exists(sidecar)) {
+		size_t size = BrotliEncoderMaxCompressedSize(html->count);
+		c->br.count = 0;
+		da_reserve(&c->br, size ? size : 64);
+		size = c->br.capacity;
+		if (BrotliEncoderCompress(MITE_BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+				html->count, (const uint8_t*)html->items, &size, (uint8_t*)c->br.items)) {
+			c->br.count = size;
+			write_if_changed(sidecar, &c->br, worker);
+			c->br_bytes += size;
+			counted = true;
+		}
+	}
+#endif
+	if (counted) {
+		c->files++;
+		c->input += html->count;
+	}
+}
 
-			const char* const start_text = p + 2;
-			const char* const start_url  = end_text + 2;
-			if (video) {
-				da_append_cstr(r->out, "<figure>\n\t<video autoplay controls muted loop playsinline width=\"100%\">\n\t\t<source src=\"");
-				da_append_many(r->out, start_url, end_url - start_url);
-				da_append_cstr(r->out, "\" type=\"video/");
-				da_append_many(r->out, format, format_len);
-				da_append_cstr(r->out, "\" alt=\"");
-				da_append_escape_html(r->out, start_text, end_text - start_text);
-				da_append_cstr(r->out, "\">\n\t</video>\n\t<figcaption>");
-				da_append_many(r->out, start_text, end_text - start_text);
-				da_append_cstr(r->out, "\n\t</figcaption>\n</figure>\n");
-			} else {
-				da_append_cstr(r->out, "<figure>\n\t<img src=\"");
-				da_append_many(r->out, start_url, end_url - start_url);
-				da_append_cstr(r->out, "\" loading=\"lazy\" alt=\"");
-				da_append_escape_html(r->out, start_text, end_text - start_text);
-				da_append_cstr(r->out, "\">\n\t<figcaption>");
-				da_append_many(r->out, start_text, end_text - start_text);
-				da_append_cstr(r->out, "</figcaption>\n</figure>\n");
-			}
-			p = end_url + 1;
+typedef struct {
+	SitePage* page;
+	render_content_func_t render;
+	render_template_func_t layout; // bound by the first stage when the layout is a literal
+	bool bound;                    // layout is known, NULL for pages without one
+	size_t size_hint;              // expected size of the output
+	const char* layout_name;       // what page->layout is when the bound layout is right
+} SiteRenderJob;
+
+typedef struct {
+	uint64_t start;
+	uint64_t render;
+	uint64_t write;
+	size_t bytes;
+	size_t worker;
+	WriteResult result;
+} SitePageTiming;
+
+// with `stream` big pages are written while they render, their render time includes the writes
+static inline WriteResult site_render_page(SiteRenderJob* job, StringBuilder* out, size_t worker,
+											SitePageTiming* timing, SiteCompressor* compressor, bool stream) {
+	SitePage* page = job->page;
+	printf("[rendering] %s\n", page->output);
+	site_scratch_begin();
+	uint64_t start = timing ? timing_now_ns() : 0;
+	render_template_func_t layout = job->layout;
+	// page->layout can still be set to another one at runtime, by a condition or another page
+	bool bound = job->bound && (page->layout && job->layout_name
+		? 0 == strcmp(page->layout, job->layout_name)
+		: page->layout == job->layout_name);
+	if (!bound) {
+		SiteTemplate* st = find_template(&global.templates, page->layout);
+		layout = st ? st->function : NULL;
+	}
+#ifndef SITE_NO_STREAM
+	// the sidecars need the whole page
+	SiteStream sink;
+	stream = stream && !compressor && job->size_hint >= SITE_STREAM_MIN;
+	if (stream) site_stream_begin(&sink, page->output, out, worker);
+	else da_reserve(out, job->size_hint);
+#else
+	stream = false;
+	da_reserve(out, job->size_hint);
+#endif
+	if (layout) layout(out, page, job->render);
+	else job->render(out, page);
+	uint64_t rendered = timing ? timing_now_ns() : 0;
+	size_t bytes = out->count;
+	WriteResult result;
+#ifndef SITE_NO_STREAM
+	if (stream) {
+		result = site_stream_end(&sink);
+		bytes = sink.total;
+	} else
+#endif
+	{
+		result = write_if_changed(page->output, out, worker);
+		if (compressor && result != WRITE_FAILED) site_write_sidecars(compressor, page->output, out, result, worker);
+	}
+	out->count = 0;
+	site_scratch_end();
+	if (timing) {
+		*timing = (SitePageTiming){
+			.start = start, .render = rendered - start, .write = timing_now_ns() - rendered,
+			.bytes = bytes, .worker = worker, .result = result,
+		};
+	}
+	return result;
+}
+
+typedef struct {
+	SiteRenderJob* jobs;
+	StringBuilder* outs;      // one per worker
+	SitePageTiming* timings;  // one per job with --timings
+	SiteCompressor* compressors; // one per worker with --compress
+	bool stream;
+	size_t written;
+	size_t unchanged;
+} SiteRenderBatch;
+
+static inline void site_render_worker(void* userdata, size_t index, size_t worker) {
+	SiteRenderBatch* batch = userdata;
+	SitePageTiming* timing = batch->timings ? &batch->timings[index] : NULL;
+	SiteCompressor* compressor = batch->compressors ? &batch->compressors[worker] : NULL;
+	WriteResult result = site_render_page(&batch->jobs[index], &batch->outs[worker], worker, timing, compressor, batch->stream);
+	if (result == WRITE_WRITTEN)   atomic_fetch_add_size(&batch->written, 1);
+	if (result == WRITE_UNCHANGED) atomic_fetch_add_size(&batch->unchanged, 1);
+}
+
+// one line per page for the first stage to report, wall clock nanoseconds:
+//   render <start> <end>
+//   page <start> <render> <write> <bytes> <worker> <result> <output>
+static inline void site_save_timings(const char* path, SiteRenderBatch* batch, size_t count, uint64_t start, uint64_t end) {
+	StringBuilder sb = {0};
+	char line[160];
+	snprintf(line, sizeof(line), "render %llu %llu\n", (unsigned long long)start, (unsigned long long)end);
+	da_append_cstr(&sb, line);
+	for (size_t i = 0; i < count; ++i) {
+		SitePageTiming* t = &batch->timings[i];
+		snprintf(line, sizeof(line), "page %llu %llu %llu %llu %d %d ",
+			(unsigned long long)t->start, (unsigned long long)t->render, (unsigned long long)t->write,
+			(unsigned long long)t->bytes, (int)t->worker, (int)t->result);
+		da_append_cstr(&sb, line);
+		da_append_cstr(&sb, batch->jobs[i].page->output);
+		da_append(&sb, '\n');
+	}
+	write_to_file(path, &sb);
+	free(sb.items);
+}
+
+static inline size_t site_pagination_count(SitePage* page) {
+	if (!page->paginate || page->per_page == 0) return 1;
+	size_t count = (page->paginate->count + page->per_page - 1) / page->per_page;
+	return count ? count : 1;
+}
+
+static inline size_t site_page_item_count(SitePage* page) {
+	if (!page->paginate) return 0;
+	if (page->page_first >= page->paginate->count) return 0;
+	size_t left = page->paginate->count - page->page_first;
+	return left < page->per_page ? left : page->per_page;
+}
+
+// url of the n-th output of a paginated page, NULL past either end
+static inline const char* site_page_url(SitePage* page, size_t n) {
+	if (n < 1 || n > (page->page_count ? page->page_count : 1)) return NULL;
+	return page->page_urls ? page->page_urls[n - 1] : page->url;
+}
+
+// "dir/index.html" as "dir/page/<n>/index.html"
+static inline char* site_pagination_path(const char* path, size_t n) {
+	const char* slash = path ? strrchr(path, '/') : NULL;
+	int dir = slash ? (int)(slash - path + 1) : 0;
+	size_t size = dir + 48;
+	char* out = site_alloc(size);
+	snprintf(out, size, "%.*spage/%d/index.html", dir, path ? path : "", (int)n);
+	return out;
+}
+
+static inline void site_make_parent_dirs(const char* path) {
+	char dir[MAX_PATH_LEN];
+	for (const char* p = path; *p && (size_t)(p - path) < sizeof(dir); ++p) {
+		if (*p != '/' || p == path) continue;
+		memcpy(dir, path, p - path);
+		dir[p - path] = '\0';
+#ifndef _WIN32
+		mkdir(dir, 0755);
+#else
+		CreateDirectoryA(dir, NULL);
+#endif
+	}
+}
+
+// a page with PAGINATE() becomes one job per output, the first renders the page itself
+// and the others a copy of it, jobs without pagination are returned as they are
+static inline SiteRenderJob* site_paginate_jobs(SiteRenderJob* jobs, size_t* count) {
+	size_t total = 0;
+	for (size_t i = 0; i < *count; ++i) total += site_pagination_count(jobs[i].page);
+	if (total == *count) return jobs;
+
+	SiteRenderJob* expanded = calloc(total + 1, sizeof(SiteRenderJob));
+	size_t j = 0;
+	for (size_t i = 0; i < *count; ++i) {
+		SitePage* page = jobs[i].page;
+		size_t n = site_pagination_count(page);
+		if (n == 1) {
+			page->page_number = page->page_count = 1;
+			expanded[j++] = jobs[i];
 			continue;
 		}
-		else if (starts_with(p, "<?")) {
-			const char* tag_end = strstr(p + 2, "?>");
-			if (tag_end) {
-				da_append_many(r->out, p, tag_end - p + 2);
-				p = tag_end + 2;
-				r->cursor = p;
-				continue;
+		const char** urls = site_alloc((n + 1) * sizeof(char*));
+		urls[0] = page->url;
+		for (size_t k = 2; k <= n; ++k) urls[k-1] = site_pagination_path(page->url, k);
+		for (size_t k = 1; k <= n; ++k) {
+			SitePage* p = page;
+			if (k > 1) {
+				p = site_alloc(sizeof(SitePage));
+				*p = *page;
+				p->url = urls[k-1];
+				p->output = site_pagination_path(page->output, k);
+				site_make_parent_dirs(p->output);
 			}
+			p->page_number = k;
+			p->page_count = n;
+			p->page_first = (k - 1) * page->per_page;
+			p->page_urls = urls;
+			expanded[j] = jobs[i];
+			expanded[j++].page = p;
 		}
+	}
+	*count = total;
+	return expanded;
+}
 
-		da_append(r->out, *p);
-		++p;
+// renders the pages from `threads` workers, each with its own output buffer
+// templates may only read the global state while rendering in parallel,
+// sorts of global collections are hoisted into prepare_global_state by the first stage
+static inline void site_render(SiteRenderJob* jobs, size_t count, size_t threads, const char* timings_path, bool compress, bool stream) {
+	if (threads < 1) threads = 1;
+	uint64_t start = timing_now_ns();
+	SiteRenderJob* paginated = site_paginate_jobs(jobs, &count);
+	SiteRenderBatch batch = { .jobs = paginated, .outs = calloc(threads, sizeof(StringBuilder)), .stream = stream };
+	if (timings_path) batch.timings = calloc(count + 1, sizeof(SitePageTiming));
+	if (compress) {
+		gzip_init();
+		batch.compressors = calloc(threads, sizeof(SiteCompressor));
 	}
+	run_parallel(threads, count, site_render_worker, &batch);
+	for (size_t i = 0; i < threads; ++i) free(batch.outs[i].items);
+	free(batch.outs);
+	printf("[written] %d files, %d unchanged\n", (int)batch.written, (int)batch.unchanged);
+	if (compress) {
+		SiteCompressor total = {0};
+		for (size_t i = 0; i < threads; ++i) {
+			SiteCompressor* c = &batch.compressors[i];
+			total.files += c->files;
+			total.input += c->input;
+			total.gz_bytes += c->gz_bytes;
+			total.br_bytes += c->br_bytes;
+			free(c->gz.items);
+			free(c->br.items);
+			free(c->head);
+			free(c->prev);
+		}
+		free(batch.compressors);
+		printf("[compressed] %d files, %.1f KB -> %.1f KB gzip", (int)total.files, total.input / 1024.0, total.gz_bytes / 1024.0);
+#ifdef MITE_USE_BROTLI
+		printf(", %.1f KB brotli", total.br_bytes / 1024.0);
+#endif
+		printf("\n");
+	}
+	if (timings_path) site_save_timings(timings_path, &batch, count, start, timing_now_ns());
+	free(batch.timings);
+	if (paginated != jobs) free(paginated);
 }
 
-// includes newline
-void append_until_newline(StringBuilder* sb, const char* str) {
-	size_t count = 0;
-	const char* cursor = str;
-	while (*cursor && *cursor != '\n') {
-		count++;
-		cursor++;
+// `--timings <path>` is passed by the first stage
+static inline const char* site_timings_from_args(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (0 == strcmp(argv[i], "--timings")) return argv[i+1];
 	}
-	da_append_many(sb, str, count + 1);
+	return NULL;
 }
-void skip_after_newline(const char** cursor) {
-	while (**cursor && **cursor != '\n') {
-		(*cursor)++;
+
+static inline bool site_compress_from_args(int argc, char** argv) {
+	for (int i = 1; i < argc; ++i) {
+		if (0 == strcmp(argv[i], "--compress")) return true;
 	}
-	if (**cursor == '\n') {
-		(*cursor)++;
+	return false;
+}
+
+static inline bool site_stream_from_args(int argc, char** argv) {
+	for (int i = 1; i < argc; ++i) {
+		if (0 == strcmp(argv[i], "--stream")) return true;
 	}
+	return false;
 }
 
-void render_md_to_html(StringBuilder* md, StringBuilder* out, StringBuilder* out_fm) {
-	MdRenderer r = { .cursor = md->items, .out = out };
+static inline size_t site_threads_from_args(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (0 == strcmp(argv[i], "-j")) {
+			int threads = atoi(argv[i+1]);
+			return threads > 0 ? (size_t)threads : 1;
+		}
+	}
+	return 1;
+}
 
-#define start_paragraph() if (!r.in_paragraph) { da_append_cstr(out,  "\n<p>\n"); r.in_paragraph = true; }
-#define   end_paragraph() if (r.in_paragraph)  { da_append_cstr(out, "</p>\n"); r.in_paragraph = false; }
-#define start_list() if (!r.in_list) { da_append_cstr(out,  "<ul>\n"); r.in_list = true; }
-#define   end_list() if (r.in_list)  { da_append_cstr(out, "</ul>\n"); r.in_list = false; }
+// ------------------- hot reload -----------------------
+// --daemon keeps the split site running as a host, built from the global state with
+// SITE_HOST. the first stage sends it every build on stdin, the host loads the rebuilt
+// templates and pages as shared objects, renders the pages and answers on `--host <fd>`
+#if defined(SITE_HOST) && !defined(_WIN32)
+extern SitePage* site_pages[];
+void construct_global_state(void);
 
-	while (*r.cursor) {
-		const char* line_end = r.cursor;
-		while (*line_end && *line_end != '\n') line_end++;
+typedef void (*site_prepare_func_t)(void);
 
-		const char* trimmed = r.cursor;
-		while (*trimmed == ' ' || *trimmed == '\t' || *trimmed == '\r') trimmed++;
+typedef struct {
+	char path[MAX_PATH_LEN];
+	void* handle;
+} SiteModule;
+
+static inline void site_module_close(SiteModule* m) {
+	if (m->handle) dlclose(m->handle);
+	m->handle = NULL;
+	m->path[0] = '\0';
+}
 
-		// empty line ends paragraph
-		if (line_end - trimmed == 0) {
-			end_paragraph();
-			end_list();
+// the symbols of RTLD_GLOBAL modules bind the undefined ones of the modules loaded after them
+static inline bool site_module_load(SiteModule* m, const char* path, int flags) {
+	if (m->handle && 0 == strcmp(m->path, path)) return true;
+	site_module_close(m);
+	m->handle = dlopen(path, RTLD_NOW | flags);
+	if (!m->handle) {
+		printf("[error] could not load %s\n", dlerror());
+		return false;
+	}
+	snprintf(m->path, sizeof(m->path), "%s", path);
+	return true;
+}
 
-		} else if (starts_with(trimmed, "<?")) {
-			const char* end = strstr(trimmed + 2, "?>");
-			if (end) {
-				da_append_many(out, trimmed, end - trimmed + 2);
-				r.cursor = end + 2;
-				continue;
-			}
-		
-		} else if (starts_with(trimmed, "---")) {
-			if (trimmed != md->items) {
-				da_append_cstr(out, "<hr>");
-				r.cursor = trimmed + 3;
+static inline void* site_module_symbol(SiteModule* m, const char* prefix, const char* name) {
+	char symbol[MAX_PATH_LEN];
+	snprintf(symbol, sizeof(symbol), "%s%s", prefix, name);
+	return m->handle ? dlsym(m->handle, symbol) : NULL;
+}
+
+static inline int site_host_fd_from_args(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (0 == strcmp(argv[i], "--host")) return atoi(argv[i+1]);
+	}
+	return -1;
+}
+
+// reads builds until stdin is closed, every module is named by the hash of its source:
+//   templates <path>
+//   page <index> <size hint> <layout, - for none, * to look it up> <name> <path>
+//   render [serial]
+// and answers `done <result>` once the pages are written
+static inline int site_host(int argc, char** argv) {
+	int reply_fd = site_host_fd_from_args(argc, argv);
+	size_t threads = site_threads_from_args(argc, argv);
+	const char* timings_path = site_timings_from_args(argc, argv);
+	bool compress = site_compress_from_args(argc, argv);
+	bool stream = site_stream_from_args(argc, argv);
+	if (reply_fd < 0) {
+		printf("[error] the host is started by mite --daemon\n");
+		return 1;
+	}
+
+	SiteModule templates = {0};
+	SiteModule* modules = calloc(global.pages.count + 1, sizeof(SiteModule));
+	struct { SiteRenderJob* items; size_t count; size_t capacity; } jobs = {0};
+	struct { site_prepare_func_t* items; size_t count; size_t capacity; } prepares = {0};
+	bool ok = true;
+
+	char line[MAX_PATH_LEN * 2];
+	while (fgets(line, sizeof(line), stdin)) {
+		line[strcspn(line, "\n")] = '\0';
+		if (0 == strncmp(line, "templates ", 10)) {
+			if (templates.handle && 0 == strcmp(templates.path, line + 10)) continue;
+			// the loaded pages are bound to the old templates
+			for (size_t i = 0; i < global.pages.count; ++i) site_module_close(&modules[i]);
+			global.templates.count = 0;
+			void (*construct)(void) = site_module_load(&templates, line + 10, RTLD_GLOBAL)
+				? (void (*)(void))dlsym(templates.handle, "construct_templates") : NULL;
+			if (construct) construct();
+			else ok = false;
+
+		} else if (0 == strncmp(line, "page ", 5)) {
+			unsigned long long index, hint;
+			char layout[MAX_PATH_LEN], name[MAX_PATH_LEN];
+			int n = 0;
+			if (4 != sscanf(line, "page %llu %llu %1023s %1023s %n", &index, &hint, layout, name, &n)
+					|| n == 0 || index >= global.pages.count) {
+				ok = false;
+				continue;
+			}
+			SiteModule* m = &modules[index];
+			if (!site_module_load(m, line + n, 0)) {
+				ok = false;
 				continue;
 			}
+			SiteRenderJob job = {
+				.page = site_pages[index],
+				.render = (render_content_func_t)site_module_symbol(m, "render_", name),
+				.bound = 0 != strcmp(layout, "*"),
+				.size_hint = hint,
+			};
+			if (0 != strcmp(layout, "-") && 0 != strcmp(layout, "*")) {
+				SiteTemplate* st = find_template(&global.templates, layout);
+				job.layout = st->function;
+				job.layout_name = st->name;
+			}
+			if (!job.render) {
+				ok = false;
+				continue;
+			}
+			site_prepare_func_t prepare = (site_prepare_func_t)site_module_symbol(m, "prepare_", name);
+			if (prepare) da_append(&prepares, prepare);
+			da_append(&jobs, job);
+
+		} else if (0 == strncmp(line, "render", 6)) {
+			// sorts that can not run before the threads start, see check_parallel_sorts
+			size_t render_threads = 0 == strcmp(line, "render serial") ? 1 : threads;
+			if (render_threads > 1) {
+				site_prepare_func_t prepare = (site_prepare_func_t)site_module_symbol(&templates, "prepare_", "templates");
+				if (prepare) prepare();
+				for (size_t i = 0; i < prepares.count; ++i) prepares.items[i]();
+			}
+			site_render(jobs.items, jobs.count, render_threads, timings_path, compress, stream);
+			fflush(stdout);
+			char reply[32];
+			snprintf(reply, sizeof(reply), "done %d\n", ok ? 0 : 1);
+			if (write(reply_fd, reply, strlen(reply)) < 0) break;
+			jobs.count = 0;
+			prepares.count = 0;
+			ok = true;
+		}
+	}
+
+	for (size_t i = 0; i < global.pages.count; ++i) site_module_close(&modules[i]);
+	site_module_close(&templates);
+	free(modules);
+	free(jobs.items);
+	free(prepares.items);
+	return 0;
+}
+#endif // SITE_HOST
+
+#define ADD_PROJECT(t, d, u) da_append(&global.projects, site_page_new_tdu((t),(d),(u)));
+#define ADD_SOCIAL(t, u)     da_append(&global.socials,  site_page_new_tdu((t),NULL,(u)));
+
+#define ADD_TO_GLOBAL_POSTS(page) da_append(&global.posts, (page));
+#define SET_POST()    da_append(&global.posts,    (page));
+#define SET_PROJECT() da_append(&global.projects, (page));
+
+#define TAG_PAGES(name) site_tag_pages(&global.tags, (name))
+
+// PAGINATE(&global.posts, 10) in the front matter renders the page once for every 10 posts,
+// the first to its output and the rest to page/<n>/index.html next to it
+#define PAGINATE(pages, n) do { page->paginate = (pages); page->per_page = (n); } while (0);
+#define PAGE_ITEM_COUNT()  site_page_item_count(page)
+#define PAGE_ITEM(i)       (page->paginate->items[page->page_first + (i)])
+#define PAGE_NUMBER()      (page->page_number ? page->page_number : 1)
+#define PAGE_COUNT()       (page->page_count ? page->page_count : 1)
+#define PAGE_URL(n)        site_page_url(page, (n))
+
+
+
+#define SITE_MAP_LINEAR_MAX 8
+
+static inline uint64_t site_map_hash(const char* key) {
+	return hash_bytes(key, strlen(key));
+}
+
+// same hash and either the same pointer, which literal keys usually are, or the same string
+static inline bool site_map_key_eq(SiteMapEntry* e, const char* key, uint64_t hash) {
+	return e->hash == hash && (e->key == key || 0 == strcmp(e->key, key));
+}
+
+static inline SiteMapEntry* site_map_find(SiteMap* map, const char* key) {
+	uint64_t hash = site_map_hash(key);
+	if (!map->table) {
+		for (size_t i = 0; i < map->count; ++i) {
+			if (site_map_key_eq(&map->items[i], key, hash)) return &map->items[i];
+		}
+		return NULL;
+	}
+	size_t mask = map->table_size - 1;
+	for (size_t slot = hash & mask; map->table[slot]; slot = (slot + 1) & mask) {
+		SiteMapEntry* e = &map->items[map->table[slot] - 1];
+		if (site_map_key_eq(e, key, hash)) return e;
+	}
+	return NULL;
+}
+
+static inline void site_map_index_insert(SiteMap* map, size_t index) {
+	size_t mask = map->table_size - 1;
+	size_t slot = map->items[index].hash & mask;
+	while (map->table[slot]) slot = (slot + 1) & mask;
+	map->table[slot] = (uint32_t)(index + 1);
+}
+
+static inline void site_map_reindex(SiteMap* map) {
+	site_free(map->table);
+	map->table_size = 32;
+	while (map->table_size < map->count * 2) map->table_size *= 2;
+	map->table = site_alloc(map->table_size * sizeof(uint32_t));
+	// only the first entry of a key is indexed
+	for (size_t i = 0; i < map->count; ++i) {
+		if (site_map_find(map, map->items[i].key) == NULL) site_map_index_insert(map, i);
+	}
+}
+
+// a key that is set again keeps its first value, like before
+static inline void site_map_set(SiteMap* map, const char* key, const char* value) {
+	if (map->count == map->capacity) {
+		size_t capacity = map->capacity ? map->capacity * 2 : 8;
+		map->items = site_grow(map->items, map->capacity * sizeof(SiteMapEntry), capacity * sizeof(SiteMapEntry));
+		map->capacity = capacity;
+	}
+	bool known = map->table && site_map_find(map, key);
+	map->items[map->count].key = key;
+	map->items[map->count].value = value;
+	map->items[map->count].hash = site_map_hash(key);
+	map->count++;
+
+	if (map->count > SITE_MAP_LINEAR_MAX && map->count * 2 > map->table_size) site_map_reindex(map);
+	else if (map->table && !known) site_map_index_insert(map, map->count - 1);
+}
+static inline const char* site_map_get(SiteMap* map, const char* key) {
+	SiteMapEntry* e = site_map_find(map, key);
+	return e ? e->value : NULL;
+}
+
+static inline bool site_map_has(SiteMap* map, const char* key) {
+	return site_map_find(map, key) != NULL;
+}
+
+static inline bool site_map_equals(SiteMap* map, const char* key, const char* value) {
+	SiteMapEntry* e = site_map_find(map, key);
+	return e && strcmp(e->value, value) == 0;
+}
+
+
+
+#define DATA_SET(obj, key, value) site_map_set(&((obj)->data), (key), (value));
+#define DATA_GET(obj, key)        site_map_get(&((obj)->data), (key))
+#define DATA_HAS(obj, key)        site_map_has(&((obj)->data), (key))
+#define DATA_IS(obj, key, value)  site_map_equals(&((obj)->data), (key), (value))
+
+#define GLOBAL_SET(key, value) DATA_SET(&global, key, value)
+#define GLOBAL_GET(key)        DATA_GET(&global, key)
+#define GLOBAL_HAS(key)        DATA_HAS(&global, key)
+#define GLOBAL_IS(key, value)  DATA_IS (&global, key, value)
+
+#define PAGE_SET(key, value) DATA_SET(page, key, value)
+#define PAGE_GET(key)        DATA_GET(page, key)
+#define PAGE_HAS(key)        DATA_HAS(page, key)
+#define PAGE_IS(key, value)  DATA_IS (page, key, value)
+
+typedef enum {
+	SITE_SORT_NONE = 0,
+	SITE_SORT_DATE,     // YYYY-MM-DD or anything else strcmp orders, newest first
+	SITE_SORT_DATE_ALT, // DD/MM/YYYY, newest first
+} SiteSortKind;
+
+typedef struct {
+	SitePage* page;
+	int64_t key;
+	size_t index;
+	bool keyed; // false for pages without a date, they go after the rest in their order
+} SiteSortEntry;
+
+// `key` or strcmp of the dates, ties keep their order
+static int site_sort_compare(const void* a, const void* b) {
+	const SiteSortEntry* x = a;
+	const SiteSortEntry* y = b;
+	if (x->keyed != y->keyed) return x->keyed ? -1 : 1;
+	if (x->keyed) {
+		if (x->key != y->key) return x->key > y->key ? -1 : 1;
+		if (x->key < 0) {
+			int cmp = strcmp(y->page->date, x->page->date);
+			if (cmp != 0) return cmp;
+		}
+	}
+	return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+// YYYY-MM-DD as yyyymmdd, -1 for dates that only strcmp can order
+static int64_t parse_date_key(const char* date) {
+	for (int i = 0; i < 10; ++i) {
+		bool dash = i == 4 || i == 7;
+		if (dash ? date[i] != '-' : !isdigit((unsigned char)date[i])) return -1;
+	}
+	if (date[10] != '\0') return -1;
+	return atoi(date) * 10000LL + atoi(date + 5) * 100LL + atoi(date + 8);
+}
+
+// DD/MM/YYYY as yyyymmdd, -2 when it does not parse
+static int64_t parse_date_key_alt(const char* date) {
+	int d, m, y;
+	if (sscanf(date, "%d/%d/%d", &d, &m, &y) != 3) return -2;
+	return y * 10000LL + m * 100LL + d;
+}
+
+// days since 1970-01-01 of a proleptic gregorian date
+static inline int64_t site_days_from_civil(int64_t y, int m, int d) {
+	y -= m <= 2;
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int64_t yoe = y - era * 400;
+	int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+// YYYY-MM-DD or DD/MM/YYYY
+static inline bool site_parse_ymd(const char* date, int* y, int* m, int* d) {
+	if (!date) return false;
+	if (sscanf(date, "%d-%d-%d", y, m, d) != 3 && sscanf(date, "%d/%d/%d", d, m, y) != 3) return false;
+	return *m >= 1 && *m <= 12 && *d >= 1 && *d <= 31;
+}
+
+static inline void site_format_dates(int y, int m, int d, char* rfc822, size_t rfc822_size, char* iso8601, size_t iso8601_size) {
+	static const char* days[] = { "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" };
+	static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+	int64_t day = site_days_from_civil(y, m, d);
+	int weekday = (int)(((day % 7) + 7) % 7);
+	if (rfc822)  snprintf(rfc822, rfc822_size, "%s, %02d %s %04d 00:00:00 +0000", days[weekday], d, months[m - 1], y);
+	if (iso8601) snprintf(iso8601, iso8601_size, "%04d-%02d-%02dT00:00:00Z", y, m, d);
+}
+
+static inline void site_parse_date(SitePage* page) {
+	if (!page || page->parsed_date == page->date) return;
+	page->parsed_date = page->date;
+	page->timestamp = 0;
+	page->rfc822[0] = page->iso8601[0] = '\0';
+	if (!page->date) return;
+	page->date_key = parse_date_key(page->date);
+	page->date_key_alt = parse_date_key_alt(page->date);
+	int y, m, d;
+	if (!site_parse_ymd(page->date, &y, &m, &d)) return;
+	page->timestamp = site_days_from_civil(y, m, d) * 86400;
+	site_format_dates(y, m, d, page->rfc822, sizeof(page->rfc822), page->iso8601, sizeof(page->iso8601));
+}
+
+// after the front matter of every page ran, pages only read their dates while rendering
+static inline void site_parse_dates(SitePages* pages) {
+	for (size_t i = 0; i < pages->count; ++i) site_parse_date(pages->items[i]);
+}
+
+static inline void site_sort(SitePages* sp, SiteSortKind kind) {
+	if (sp->hoisted) return;
+	if (sp->sorted_by == (int)kind && sp->sorted_count == sp->count) return;
+
+	SiteSortEntry* entries = calloc(sp->count + 1, sizeof(SiteSortEntry));
+	bool any_string_key = false;
+	for (size_t i = 0; i < sp->count; ++i) {
+		SiteSortEntry* e = &entries[i];
+		e->page = sp->items[i];
+		e->index = i;
+		e->keyed = e->page && e->page->date;
+		if (!e->keyed) continue;
+		site_parse_date(e->page);
+		e->key = kind == SITE_SORT_DATE ? e->page->date_key : e->page->date_key_alt;
+		if (e->key == -2) e->keyed = false;
+		if (e->key == -1) any_string_key = true;
+	}
+	// a single date outside YYYY-MM-DD means comparing all of them as strings
+	if (any_string_key) {
+		for (size_t i = 0; i < sp->count; ++i) entries[i].key = -1;
+	}
+
+	qsort(entries, sp->count, sizeof(SiteSortEntry), site_sort_compare);
+	for (size_t i = 0; i < sp->count; ++i) sp->items[i] = entries[i].page;
+	free(entries);
+
+	sp->sorted_by = kind;
+	sp->sorted_count = sp->count;
+}
+
+static inline void sort_pages(SitePages* sp) {
+	site_sort(sp, SITE_SORT_DATE);
+}
+
+static inline void sort_pages_alt(SitePages* sp) {
+	site_sort(sp, SITE_SORT_DATE_ALT);
+}
+
+// the sorts found in templates and pages run once before the workers start, the same
+// calls from the workers would sort the shared collection at the same time
+static inline void site_hoist_sort(SitePages* sp, SiteSortKind kind) {
+	sp->hoisted = false;
+	site_sort(sp, kind);
+	sp->hoisted = true;
+}
+
+static inline SiteTag* site_tag_find(SiteTags* tags, const char* name, size_t len) {
+	if (!tags->table) return NULL;
+	size_t mask = tags->table_size - 1;
+	for (size_t slot = hash_bytes(name, len) & mask; tags->table[slot]; slot = (slot + 1) & mask) {
+		SiteTag* tag = &tags->items[tags->table[slot] - 1];
+		if (0 == strncmp(tag->name, name, len) && tag->name[len] == '\0') return tag;
+	}
+	return NULL;
+}
+
+static inline void site_tags_reindex(SiteTags* tags) {
+	free(tags->table);
+	tags->table_size = 32;
+	while (tags->table_size < tags->count * 2) tags->table_size *= 2;
+	tags->table = calloc(tags->table_size, sizeof(uint32_t));
+	size_t mask = tags->table_size - 1;
+	for (size_t i = 0; i < tags->count; ++i) {
+		size_t slot = hash_bytes(tags->items[i].name, strlen(tags->items[i].name)) & mask;
+		while (tags->table[slot]) slot = (slot + 1) & mask;
+		tags->table[slot] = (uint32_t)(i + 1);
+	}
+}
+
+static inline SiteTag* site_tag_add(SiteTags* tags, const char* name, size_t len) {
+	SiteTag* tag = site_tag_find(tags, name, len);
+	if (tag) return tag;
+	char* copy = site_alloc(len + 1);
+	memcpy(copy, name, len);
+	SiteTag added = { .name = copy, .pages = site_alloc(sizeof(SitePages)) };
+	da_append(tags, added);
+	if (tags->table_size < tags->count * 2) {
+		site_tags_reindex(tags);
+	} else {
+		size_t mask = tags->table_size - 1;
+		size_t slot = hash_bytes(name, len) & mask;
+		while (tags->table[slot]) slot = (slot + 1) & mask;
+		tags->table[slot] = (uint32_t)tags->count;
+	}
+	return &tags->items[tags->count - 1];
+}
+
+static inline int site_tag_compare(const void* a, const void* b) {
+	return strcmp(((const SiteTag*)a)->name, ((const SiteTag*)b)->name);
+}
+
+// the pages of a tag, newest first. called from the front matter, before the index is
+// built, it returns the collection that is filled in later, so it can be passed to PAGINATE()
+static inline SitePages* site_tag_pages(SiteTags* tags, const char* name) {
+	static SitePages none = { .sorted_by = SITE_SORT_DATE };
+	if (!name) return &none;
+	if (!tags->indexed) return site_tag_add(tags, name, strlen(name))->pages;
+	SiteTag* tag = site_tag_find(tags, name, strlen(name));
+	return tag ? tag->pages : &none;
+}
+
+// splits the tags of every page once, so a listing of a tag costs only its own pages
+static inline void site_index_tags(SiteTags* tags, SitePages* pages) {
+	for (size_t i = 0; i < pages->count; ++i) {
+		SitePage* page = pages->items[i];
+		if (!page || !page->tags) continue;
+		for (const char* p = page->tags; *p; ) {
+			while (*p == ' ' || *p == '\t' || *p == ',') p++;
+			const char* word = p;
+			while (*p && *p != ' ' && *p != '\t' && *p != ',') p++;
+			if (p == word) continue;
+			SitePages* tagged = site_tag_add(tags, word, p - word)->pages;
+			// a tag repeated on the same page
+			if (tagged->count && tagged->items[tagged->count - 1] == page) continue;
+			da_append(tagged, page);
+		}
+	}
+	qsort(tags->items, tags->count, sizeof(SiteTag), site_tag_compare);
+	site_tags_reindex(tags);
+	for (size_t i = 0; i < tags->count; ++i) sort_pages(tags->items[i].pages);
+	tags->indexed = true;
+}
+
+static inline char* format_rfc822(const char *ymd) {
+	char* out = site_scratch(32);
+	int y, m, d;
+	if (site_parse_ymd(ymd, &y, &m, &d)) site_format_dates(y, m, d, out, 32, NULL, 0);
+	return out;
+}
+
+static inline char* format_iso8601(const char *ymd) {
+	char* out = site_scratch(24);
+	int y, m, d;
+	if (site_parse_ymd(ymd, &y, &m, &d)) site_format_dates(y, m, d, NULL, 0, out, 24);
+	return out;
+}
+
+// the cached strings of pages parsed by site_parse_dates, formatted on the spot otherwise
+static inline const char* page_rfc822(SitePage* page) {
+	if (!page || !page->date) return NULL;
+	if (page->parsed_date == page->date) return page->rfc822;
+	return format_rfc822(page->date);
+}
+
+static inline const char* page_iso8601(SitePage* page) {
+	if (!page || !page->date) return NULL;
+	if (page->parsed_date == page->date) return page->iso8601;
+	return format_iso8601(page->date);
+}
+
+
+
+
+
+#else // #ifdef SECOND_STAGE
+
+
+
+
+
+bool file_exists(const char* path) {
+#ifndef _WIN32
+	return access(path, F_OK) == 0;
+#else
+	DWORD attrs = GetFileAttributesA(path);
+	return (attrs != INVALID_FILE_ATTRIBUTES) && !(attrs & FILE_ATTRIBUTE_DIRECTORY);
+#endif
+}
+
+static inline int execute_line(const char* line) {
+	fflush(stdout);
+#ifndef _WIN32
+	return system(line);
+#else
+	#define CMD_LINE_MAX 2000
+	char full_command[CMD_LINE_MAX + 16];
+	snprintf(full_command, sizeof(full_command), "cmd /C \"%s\"", line);
+	return system(full_command);
+#endif
+}
+
+
+// --split objects and the cached site binary
+#define MITE_BUILD_DIR "./.mite-build"
+
+#ifndef _WIN32
+	#define MITE_CC "cc -pthread"
+	#define SITE_BINARY "site"
+	#define SITE_RUN "./site"
+	#define SITE_CACHED_BINARY MITE_BUILD_DIR"/site"
+	#define SITE_CACHED_RUN SITE_CACHED_BINARY
+#else
+	#define MITE_CC "gcc"
+	#define SITE_BINARY "site.exe"
+	#define SITE_RUN "site.exe"
+	#define SITE_CACHED_BINARY MITE_BUILD_DIR"/site.exe"
+	#define SITE_CACHED_RUN ".mite-build\\site.exe"
+#endif
+#define SITE_CACHED_HASH_PATH MITE_BUILD_DIR"/site.hash"
+
+// ------------------- timings --------------------------
+// --timings measures the phases of a build, the site reports its pages in MITE_TIMINGS_PATH
+#define MITE_TIMINGS_PATH MITE_BUILD_DIR"/timings.txt"
+#define MITE_TRACE_PATH MITE_BUILD_DIR"/trace.json"
+#define MITE_TIMINGS_TOP 10
+
+typedef struct {
+	const char* name;
+	uint64_t start;
+	uint64_t wall;
+	uint64_t cpu;   // of this process and the finished commands it started
+} MitePhase;
+
+typedef struct {
+	uint64_t start;
+	uint64_t wall;
+} MiteSpan;
+
+// a translation unit compiled by --split
+typedef struct {
+	char* name;
+	MiteSpan span;
+} MiteUnitTiming;
+
+static struct {
+	MitePhase* items;
+	size_t count;
+	size_t capacity;
+	bool enabled;
+	struct { MiteUnitTiming* items; size_t count; size_t capacity; } units;
+} g_timings;
+
+static inline uint64_t timing_cpu_ns(void) {
+#ifndef _WIN32
+	struct rusage self, children;
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+	uint64_t us = 0;
+	us += (uint64_t)self.ru_utime.tv_sec * 1000000ULL + (uint64_t)self.ru_utime.tv_usec;
+	us += (uint64_t)self.ru_stime.tv_sec * 1000000ULL + (uint64_t)self.ru_stime.tv_usec;
+	us += (uint64_t)children.ru_utime.tv_sec * 1000000ULL + (uint64_t)children.ru_utime.tv_usec;
+	us += (uint64_t)children.ru_stime.tv_sec * 1000000ULL + (uint64_t)children.ru_stime.tv_usec;
+	return us * 1000ULL;
+#else
+	// commands run through system() are not included here
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return 0;
+	ULARGE_INTEGER k = { .LowPart = kernel.dwLowDateTime, .HighPart = kernel.dwHighDateTime };
+	ULARGE_INTEGER u = { .LowPart = user.dwLowDateTime, .HighPart = user.dwHighDateTime };
+	return (k.QuadPart + u.QuadPart) * 100ULL;
+#endif
+}
+
+static inline size_t timing_begin(const char* name) {
+	if (!g_timings.enabled) return 0;
+	da_append(&g_timings, ((MitePhase){ .name = name, .start = timing_now_ns(), .cpu = timing_cpu_ns() }));
+	return g_timings.count - 1;
+}
+
+static inline void timing_end(size_t phase) {
+	if (!g_timings.enabled || phase >= g_timings.count) return;
+	MitePhase* p = &g_timings.items[phase];
+	p->wall = timing_now_ns() - p->start;
+	p->cpu = timing_cpu_ns() - p->cpu;
+}
+
+bool make_directory(const char* path);
+
+// --compress, the site writes the sidecars
+static bool g_compress_output;
+
+// --fingerprint, the site links assets by the hash of their contents
+static bool g_fingerprint_assets;
+
+// --stream, the site writes big pages while it renders them
+static bool g_stream_output;
+
+// set by check_parallel_sorts, the site renders on one thread whatever -j says
+static bool g_render_serial;
+
+typedef struct {
+	char* path;     // from the site root, "css/style.css"
+	char* url;      // of the hashed copy, "/css/style.1a2b3c4d.css", "/css/style.css" while missing
+	uint64_t mtime;
+	uint64_t size;
+	uint64_t hash;  // of the contents, 0 while missing
+	bool used;
+} MiteAsset;
+
+typedef struct {
+	MiteAsset* items;
+	size_t count;
+	size_t capacity;
+
+	// open addressing index on the path, slots hold the item index + 1
+	size_t* table;
+	size_t table_size;
+	size_t hashed;
+	size_t copied;
+} MiteAssets;
+
+// every asset of the last builds, kept sorted by path for the table of the site
+static MiteAssets g_assets;
+
+// sites built by a mite with MITE_USE_BROTLI link libbrotlienc
+#ifdef MITE_USE_BROTLI
+	#define MITE_SITE_LIBS " -lbrotlienc"
+#else
+	#define MITE_SITE_LIBS ""
+#endif
+
+// appends the arguments of the generated site, `-j N` renders the pages in parallel
+static inline void append_site_args(char* line, size_t size, size_t jobs) {
+	if (jobs > 1) snprintf(line + strlen(line), size - strlen(line), " -j %d", (int)jobs);
+	if (g_compress_output) snprintf(line + strlen(line), size - strlen(line), " --compress");
+	if (g_stream_output) snprintf(line + strlen(line), size - strlen(line), " --stream");
+	if (g_timings.enabled && make_directory(MITE_BUILD_DIR)) {
+		snprintf(line + strlen(line), size - strlen(line), " --timings "MITE_TIMINGS_PATH);
+	}
+}
+
+bool file_exists(const char* path);
+
+#ifdef MITE_USE_LIBTCC
+#include <libtcc.h>
+
+static void tcc_error_handler(void* opaque, const char* msg) {
+	(void)opaque;
+	printf("[tcc] %s\n", msg);
+}
+
+// compiles the site with libtcc and runs its main() in this process, no compiler or site process is started
+static inline int build_and_run_site_in_process(StringBuilder* code, size_t jobs) {
+	TCCState* tcc = tcc_new();
+	if (!tcc) return 1;
+	tcc_set_error_func(tcc, NULL, tcc_error_handler);
+	tcc_set_output_type(tcc, TCC_OUTPUT_MEMORY);
+#ifndef _WIN32
+	tcc_add_library(tcc, "pthread");
+#endif
+#ifdef MITE_USE_BROTLI
+	tcc_add_library(tcc, "brotlienc");
+#endif
+
+	StringBuilder source = {0};
+	da_append_many(&source, code->items, code->count);
+	da_append(&source, '\0');
+
+	int result = 1;
+	size_t phase = timing_begin("compile");
+	bool compiled = tcc_compile_string(tcc, source.items) == 0
+#ifdef TCC_RELOCATE_AUTO
+		&& tcc_relocate(tcc, TCC_RELOCATE_AUTO) >= 0;
+#else
+		&& tcc_relocate(tcc) >= 0;
+#endif
+	timing_end(phase);
+	if (compiled) {
+		int (*site_main)(int, char**) = (int (*)(int, char**))tcc_get_symbol(tcc, "main");
+		if (!site_main) printf("[error] the site has no main()\n");
+		if (site_main) {
+			char jobs_arg[32];
+			snprintf(jobs_arg, sizeof(jobs_arg), "%d", (int)jobs);
+			char* argv[8] = { "site" };
+			int argc = 1;
+			if (jobs > 1) { argv[argc++] = "-j"; argv[argc++] = jobs_arg; }
+			if (g_timings.enabled && make_directory(MITE_BUILD_DIR)) { argv[argc++] = "--timings"; argv[argc++] = MITE_TIMINGS_PATH; }
+			if (g_compress_output) argv[argc++] = "--compress";
+			if (g_stream_output) argv[argc++] = "--stream";
+			fflush(stdout);
+			phase = timing_begin("run");
+#ifndef _WIN32
+			// the site runs in a child, an exit() of the site must not end --watch or --serve
+			pid_t pid = fork();
+			if (pid == 0) {
+				int code = site_main(argc, argv);
+				fflush(stdout);
+				_exit(code);
+			}
+			int status = 0;
+			if (pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status)) result = WEXITSTATUS(status);
+			else printf("[error] the site did not finish\n");
+#else
+			result = site_main(argc, argv);
+#endif
+			timing_end(phase);
+			fflush(stdout);
+		}
+	}
+	free(source.items);
+	tcc_delete(tcc);
+	return result;
+}
+#endif
+
+// with `cached` the binary is kept in MITE_BUILD_DIR and only rebuilt when site.c changes,
+// site.c starts with the hash of mite.c and the options, see codegen_source_hash
+static inline int build_and_run_site(StringBuilder* code, size_t jobs, bool cached, bool watching) {
+#ifdef MITE_USE_LIBTCC
+#ifdef _WIN32
+	// without fork() an exit() of the site would end the watcher, it is compiled and run as its own process then
+	if (!watching)
+#endif
+	return build_and_run_site_in_process(code, jobs);
+#endif
+	(void)watching;
+	char line[256] = SITE_RUN;
+	if (!cached || !make_directory(MITE_BUILD_DIR)) {
+		size_t phase = timing_begin("compile");
+		int result = execute_line(MITE_CC" -o "SITE_BINARY" site.c"MITE_SITE_LIBS);
+		timing_end(phase);
+		if (result != 0) return result;
+		append_site_args(line, sizeof(line), jobs);
+		phase = timing_begin("run");
+		result = execute_line(line);
+		timing_end(phase);
+		return result;
+	}
+
+	char hash[32];
+	snprintf(hash, sizeof(hash), "%016llx\n", (unsigned long long)(hash_bytes(code->items, code->count) ^ hash_bytes(MITE_CC MITE_SITE_LIBS, strlen(MITE_CC MITE_SITE_LIBS))));
+	StringBuilder previous = {0};
+	bool hit = file_exists(SITE_CACHED_HASH_PATH) && read_entire_file(SITE_CACHED_HASH_PATH, &previous)
+			&& previous.count == strlen(hash) && 0 == memcmp(previous.items, hash, previous.count)
+			&& file_exists(SITE_CACHED_BINARY);
+	free(previous.items);
+
+	if (hit) {
+		printf("[cached] site\n");
+	} else {
+		remove(SITE_CACHED_HASH_PATH);
+		size_t phase = timing_begin("compile");
+		int compiled = execute_line(MITE_CC" -o "SITE_CACHED_BINARY" site.c"MITE_SITE_LIBS);
+		timing_end(phase);
+		if (compiled != 0) return 1;
+		StringBuilder sb = {0};
+		da_append_cstr(&sb, hash);
+		write_to_file(SITE_CACHED_HASH_PATH, &sb);
+		free(sb.items);
+	}
+
+	snprintf(line, sizeof(line), "%s", SITE_CACHED_RUN);
+	append_site_args(line, sizeof(line), jobs);
+	size_t phase = timing_begin("run");
+	int result = execute_line(line);
+	timing_end(phase);
+	return result;
+}
+
+static inline void cleanup_site() {
+#ifndef _WIN32
+	remove("site.c");
+	remove("site");
+#else
+	DeleteFileA("site.c");
+	DeleteFileA("site.exe");
+#endif
+}
+
+bool make_directory(const char* path) {
+#ifndef _WIN32
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#else
+	return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#endif
+}
+
+// runs the lines with at most `jobs` of them at the same time, false if any of them fails.
+// spans, if given, get when every line started and how long it ran
+bool execute_lines_parallel(const char** lines, size_t count, size_t jobs, MiteSpan* spans) {
+	bool ok = true;
+	if (jobs <= 1) {
+		for (size_t i = 0; i < count && ok; ++i) {
+			if (spans) spans[i].start = timing_now_ns();
+			ok = execute_line(lines[i]) == 0;
+			if (spans) spans[i].wall = timing_now_ns() - spans[i].start;
+		}
+		return ok;
+	}
+	fflush(stdout);
+
+#ifndef _WIN32
+	pid_t* pids = spans ? calloc(count + 1, sizeof(pid_t)) : NULL;
+	size_t next = 0;
+	size_t running = 0;
+	while (next < count || running > 0) {
+		while (ok && running < jobs && next < count) {
+			if (spans) spans[next].start = timing_now_ns();
+			pid_t pid = fork();
+			if (pid == 0) {
+				execl("/bin/sh", "sh", "-c", lines[next], NULL);
+				_exit(127);
+			}
+			if (pid < 0) { ok = false; break; }
+			if (pids) pids[next] = pid;
+			running++;
+			next++;
+		}
+		if (running == 0) break;
+
+		int status = 0;
+		pid_t pid = wait(&status);
+		if (pid < 0) break;
+		running--;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+		for (size_t i = 0; pids && i < next; ++i) {
+			if (pids[i] != pid) continue;
+			spans[i].wall = timing_now_ns() - spans[i].start;
+			pids[i] = 0;
+			break;
+		}
+	}
+	free(pids);
+#else
+	HANDLE* procs = calloc(jobs, sizeof(HANDLE));
+	size_t* ids = calloc(jobs, sizeof(size_t));
+	size_t next = 0;
+	size_t running = 0;
+	while (next < count || running > 0) {
+		while (ok && running < jobs && next < count) {
+			char full_command[CMD_LINE_MAX + 16];
+			snprintf(full_command, sizeof(full_command), "cmd /C \"%s\"", lines[next]);
+			PROCESS_INFORMATION pi;
+			STARTUPINFO si = {0};
+			si.cb = sizeof(si);
+			if (spans) spans[next].start = timing_now_ns();
+			if (!CreateProcess(NULL, full_command, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) { ok = false; break; }
+			CloseHandle(pi.hThread);
+			ids[running] = next++;
+			procs[running++] = pi.hProcess;
+		}
+		if (running == 0) break;
+
+		DWORD index = WaitForMultipleObjects((DWORD)running, procs, FALSE, INFINITE) - WAIT_OBJECT_0;
+		if (index >= running) break;
+		DWORD exit_code = 1;
+		GetExitCodeProcess(procs[index], &exit_code);
+		if (exit_code != 0) ok = false;
+		if (spans) spans[ids[index]].wall = timing_now_ns() - spans[ids[index]].start;
+		CloseHandle(procs[index]);
+		procs[index] = procs[--running];
+		ids[index] = ids[running];
+	}
+	free(procs);
+	free(ids);
+#endif
+	return ok;
+}
+
+
+
+
+// ------------------- md2html --------------------------
+// remembers the last answer of a forward search, so scanning for a delimiter that does not come
+// never rereads the same bytes. `found` stays the first match for any start between `from` and it
+typedef struct {
+	const char* from;
+	const char* found;
+} MdSearch;
+
+typedef struct {
+	StringBuilder* out;
+	const char* cursor;
+	bool in_paragraph;
+	bool in_list;
+	MdSearch code_end; // "?>" through the whole document
+	StringView asset_dir; // --fingerprint, local images and videos link through ASSET() relative to it
+} MdRenderer;
+
+static inline bool is_html_special(char c) {
+	return c == '<' || c == '>' || c == '&' || c == '\'' || c == '"';
+}
+
+#ifdef MITE_SSE2
+static inline unsigned count_trailing_zeros(unsigned mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+#else
+	return (unsigned)__builtin_ctz(mask);
+#endif
+}
+#endif
+
+// index of the first character that has to be escaped, count if there is none
+static inline size_t find_html_special(const char* in, size_t count) {
+	// specials often come in clusters, short runs are cheaper to check one by one
+	size_t i = 0;
+	for (; i < count && i < 8; ++i) {
+		if (is_html_special(in[i])) return i;
+	}
+#if defined(MITE_SSE2)
+	const __m128i lt = _mm_set1_epi8('<'), gt = _mm_set1_epi8('>'), amp = _mm_set1_epi8('&');
+	const __m128i apos = _mm_set1_epi8('\''), quot = _mm_set1_epi8('"');
+	for (; i + 16 <= count; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+					_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, apos)), _mm_cmpeq_epi8(v, quot)));
+		unsigned mask = (unsigned)_mm_movemask_epi8(m);
+		if (mask) return i + count_trailing_zeros(mask);
+	}
+#elif defined(MITE_NEON)
+	const uint8x16_t lt = vdupq_n_u8('<'), gt = vdupq_n_u8('>'), amp = vdupq_n_u8('&');
+	const uint8x16_t apos = vdupq_n_u8('\''), quot = vdupq_n_u8('"');
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t v = vld1q_u8((const uint8_t*)(in + i));
+		uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, lt), vceqq_u8(v, gt)),
+					vorrq_u8(vorrq_u8(vceqq_u8(v, amp), vceqq_u8(v, apos)), vceqq_u8(v, quot)));
+		// four bits per byte
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+		if (mask) return i + (size_t)(__builtin_ctzll(mask) >> 2);
+	}
+#endif
+	for (; i < count; ++i) {
+		if (is_html_special(in[i])) return i;
+	}
+	return count;
+}
+
+// specials closer than ESCAPE_DENSE_RUN to each other are escaped one by one until a clean
+// run of ESCAPE_DENSE_CLEAN bytes, a vector scan would stop again right after it started
+#define ESCAPE_DENSE_RUN 8
+#define ESCAPE_DENSE_CLEAN 32
+
+// escapes through a pointer into room for the worst case, returns the bytes it consumed
+static inline size_t escape_html_dense(StringBuilder* out, const char* in, size_t count) {
+	size_t i = 0;
+	size_t clean = 0;
+	while (i < count && clean < ESCAPE_DENSE_CLEAN) {
+		size_t end = count - i < 64 ? count : i + 64;
+		da_reserve(out, out->count + (end - i) * 6);
+		char* dst = out->items + out->count;
+		for (; i < end && clean < ESCAPE_DENSE_CLEAN; ++i) {
+			switch ((unsigned char)in[i]) {
+				case '<':  memcpy(dst, "&lt;", 4);   dst += 4; clean = 0; break;
+				case '>':  memcpy(dst, "&gt;", 4);   dst += 4; clean = 0; break;
+				case '&':  memcpy(dst, "&amp;", 5);  dst += 5; clean = 0; break;
+				case '\'': memcpy(dst, "&#39;", 5);  dst += 5; clean = 0; break;
+				case '"':  memcpy(dst, "&quot;", 6); dst += 6; clean = 0; break;
+				default:   *dst++ = in[i]; clean++; break;
+			}
+		}
+		out->count = (size_t)(dst - out->items);
+	}
+	return i;
+}
+
+// copies the clean runs in bulk, only the special characters are handled one by one
+void da_append_escape_html(StringBuilder* out, const char* in, size_t count) {
+	da_reserve(out, out->count + count);
+	size_t i = 0;
+	while (i < count) {
+		size_t run = find_html_special(in + i, count - i);
+		if (run > 0) da_append_many(out, in + i, run);
+		i += run;
+		if (i >= count) break;
+
+		if (run < ESCAPE_DENSE_RUN) {
+			i += escape_html_dense(out, in + i, count - i);
+			continue;
+		}
+		switch ((unsigned char)in[i]) {
+			case '<':  da_append_many(out, "&lt;", 4);   break;
+			case '>':  da_append_many(out, "&gt;", 4);   break;
+			case '&':  da_append_many(out, "&amp;", 5);  break;
+			case '\'': da_append_many(out, "&#39;", 5);  break;
+			case '"':  da_append_many(out, "&quot;", 6); break;
+		}
+		i++;
+	}
+}
+
+const char* search_str_until_newline(const char* haystack, const char* needle) {
+	if (!haystack) return NULL;
+	if (!*needle) return haystack;
+
+	const char* hay = haystack;
+	const char* ndl = needle;
+
+	while (*hay && *hay != '\n') {
+		const char* h_sub = hay;
+		const char* n_sub = ndl;
+
+		while (*n_sub) {
+			if (*h_sub == '\n' || *h_sub == '\0') break;
+			if (*h_sub != *n_sub) break;
+			h_sub++;
+			n_sub++;
+		}
+		if (*n_sub == '\0') return hay;
+
+		hay++;
+	}
+
+	return NULL;
+}
+
+size_t sv_strstr(StringView haystack, StringView needle) {
+	if (needle.count == 0) return 0;
+	if (haystack.count < needle.count) return haystack.count;
+
+	for (size_t i = 0; i <= haystack.count - needle.count; ++i) {
+		if (memcmp(haystack.items + i, needle.items, needle.count) == 0) {
+			return i;
+		}
+	}
+	return haystack.count;
+}
+
+bool starts_with(const char* line, const char* prefix) {
+	return strncmp(line, prefix, strlen(prefix)) == 0;
+}
+bool word_starts_with(const char* line, const char* prefix) {
+	size_t len = strlen(prefix);
+	return strncmp(line, prefix, len) == 0 && (*(line+len) != ' ');
+}
+static inline bool md_search_cached(MdSearch* s, const char* from) {
+	return s->from && from >= s->from && (!s->found || from <= s->found);
+}
+static inline const char* md_search_until_newline(MdSearch* s, const char* from, const char* needle) {
+	if (!md_search_cached(s, from)) {
+		s->from = from;
+		s->found = search_str_until_newline(from, needle);
+	}
+	return s->found;
+}
+static inline const char* md_search(MdSearch* s, const char* from, const char* needle) {
+	if (!md_search_cached(s, from)) {
+		s->from = from;
+		s->found = strstr(from, needle);
+	}
+	return s->found;
+}
+static inline const char* md_word_ends_with(MdSearch* s, const char* line, const char* prefix) {
+	const char* end = md_search_until_newline(s, line, prefix);
+	if (end && (*(end-1) == ' ')) return NULL;
+	return end;
+}
+
+// characters that may start an inline element, everything else is copied as is
+static const bool md_inline_special[256] = {
+	['\0'] = true, ['\n'] = true, ['\r'] = true, [' '] = true,
+	['*'] = true, ['_'] = true, ['`'] = true, ['\\'] = true,
+	['['] = true, ['!'] = true, ['<'] = true,
+};
+
+// normalizes the path of a local url into `out` relative to the site root,
+// fails on urls with a scheme, a query or a fragment and on ".." past the root
+static bool md_asset_path(StringView dir, const char* url, size_t len, char* out, size_t size) {
+	if (len == 0 || (len > 1 && url[0] == '/' && url[1] == '/')) return false;
+	for (size_t i = 0; i < len; ++i) {
+		char c = url[i];
+		if (c == ':' || c == '?' || c == '#' || c == '"' || c == '\\' || c == '<' || c == '>' || c == ' ' || c == '\t') return false;
+	}
+
+	char joined[MAX_PATH_LEN];
+	if (url[0] == '/') {
+		if (len >= sizeof(joined)) return false;
+		memcpy(joined, url, len);
+		joined[len] = '\0';
+	} else {
+		if (dir.count + 1 + len >= sizeof(joined)) return false;
+		memcpy(joined, dir.items, dir.count);
+		joined[dir.count] = '/';
+		memcpy(joined + dir.count + 1, url, len);
+		joined[dir.count + 1 + len] = '\0';
+	}
+
+	size_t n = 0;
+	for (const char* seg = joined; *seg; ) {
+		const char* end = seg;
+		while (*end && *end != '/') end++;
+		size_t seg_len = end - seg;
+		if (seg_len == 2 && seg[0] == '.' && seg[1] == '.') {
+			if (n == 0) return false;
+			while (n > 0 && out[n-1] != '/') n--;
+			if (n > 0) n--;
+		} else if (seg_len > 0 && !(seg_len == 1 && seg[0] == '.')) {
+			if (n + seg_len + 2 > size) return false;
+			if (n > 0) out[n++] = '/';
+			memcpy(out + n, seg, seg_len);
+			n += seg_len;
+		}
+		seg = *end ? end + 1 : end;
+	}
+	out[n] = '\0';
+	return n > 0;
+}
+
+// the url of an image or video, local ones are looked up by the site with ASSET()
+static void md_append_asset_url(MdRenderer* r, const char* url, size_t len) {
+	char path[MAX_PATH_LEN];
+	if (!r->asset_dir.items || !md_asset_path(r->asset_dir, url, len, path, sizeof(path))) {
+		da_append_many(r->out, url, len);
+		return;
+	}
+	da_append_cstr(r->out, "<? ASSET(\"/");
+	da_append_cstr(r->out, path);
+	da_append_cstr(r->out, "\") ?>");
+}
+
+// every search for a closing delimiter is cached in `search`, so a line full of unmatched
+// delimiters is still parsed in linear time
+void parse_inline(MdRenderer* r, const char* line) {
+	enum {
+		SEARCH_STRONG_ITALIC, SEARCH_STRONG_ITALIC_US, SEARCH_ITALIC_US_STRONG, SEARCH_STRONG,
+		SEARCH_ITALIC, SEARCH_ITALIC_US, SEARCH_CODE, SEARCH_MATH, SEARCH_BRACKET, SEARCH_PAREN,
+		SEARCH_COUNT
+	};
+	MdSearch search[SEARCH_COUNT] = {0};
+
+#define PARSE_INLINE_TAG(start, end, html_start, html_end, slot)       \
+	else if (word_starts_with(p, start)) {                             \
+		size_t start_len = sizeof(start) - 1;                          \
+		size_t end_len   = sizeof(end) - 1;                            \
+		const char* tag_end = md_word_ends_with(&search[slot], p + start_len, end); \
+		if (tag_end) {                                                 \
+			p += start_len;                                            \
+			da_append_cstr(r->out, html_start);                        \
+			da_append_escape_html(r->out, p, tag_end - p);             \
+			da_append_cstr(r->out, html_end);                          \
+			p = tag_end + end_len;                                     \
+			continue;                                                  \
+		}                                                              \
+	}
+
+	const char* p = line;
+	while (*p && (*p != '\r') && (*p != '\n')) {
+		const char* plain = p;
+		while (!md_inline_special[(unsigned char)*p]) p++;
+		if (p > plain) {
+			da_append_many(r->out, plain, p - plain);
+			continue;
+		}
+
+		// double space line break
+		if (starts_with(p, "  \n") || starts_with(p, "  \r\n")) {
+			da_append_cstr(r->out, "<br>\n");
+			p += 3;
+			break;
+		}
+
+		if (false) {}
+		PARSE_INLINE_TAG("***", "***", "<strong><i>", "</i></strong>", SEARCH_STRONG_ITALIC)
+		PARSE_INLINE_TAG("**_", "_**", "<strong><i>", "</i></strong>", SEARCH_STRONG_ITALIC_US)
+		PARSE_INLINE_TAG("_**", "**_", "<strong><i>", "</i></strong>", SEARCH_ITALIC_US_STRONG)
+		PARSE_INLINE_TAG("**", "**", "<strong>", "</strong>", SEARCH_STRONG)
+		PARSE_INLINE_TAG("*", "*", "<i>", "</i>", SEARCH_ITALIC)
+		PARSE_INLINE_TAG("_", "_", "<i>", "</i>", SEARCH_ITALIC_US)
+		PARSE_INLINE_TAG("`", "`", "<code>", "</code>", SEARCH_CODE)
+		PARSE_INLINE_TAG("\\(", "\\)", "\\(", "\\)", SEARCH_MATH)
+		else if (*p == '[') {
+			const char* end_text = md_search_until_newline(&search[SEARCH_BRACKET], p, "]");
+			if (!end_text || end_text[1] != '(') {
+				da_append_escape_html(r->out, p, 1);
+				++p;
+				continue;
+			}
+			const char* end_url = md_search_until_newline(&search[SEARCH_PAREN], end_text + 2, ")");
+			if (!end_url) break;
+			da_append_cstr(r->out, "<a href=\"");
+			da_append_many(r->out, end_text + 2, end_url - (end_text + 2));
+			da_append_cstr(r->out, "\">");
+			da_append_escape_html(r->out, p + 1, end_text - (p + 1));
+			da_append_cstr(r->out, "</a>");
+			p = end_url + 1;
+			continue;
+		}
+		// figure
+		else if (starts_with(p, "![")) {
+			const char* end_text = md_search_until_newline(&search[SEARCH_BRACKET], p+2, "]");
+			if (!end_text || end_text[1] != '(') {
+				da_append_many(r->out, p, 2);
+				p += 2;
+				continue;
+			}
+			const char* end_url = md_search_until_newline(&search[SEARCH_PAREN], end_text + 2, ")");
+			if (!end_url) break;
+
+			const char* format = end_url;
+			while (format > end_text && *(format-1) != '.') --format;
+
+			const size_t format_len = end_url - format;
+			bool video = false;
+			if (format_len == 3 && 0 == strncmp(format, "mp4",  3)) video = true;
+			if (format_len == 4 && 0 == strncmp(format, "webm", 4)) video = true;
+
+			const char* const start_text = p + 2;
+			const char* const start_url  = end_text + 2;
+			if (video) {
+				da_append_cstr(r->out, "<figure>\n\t<video autoplay controls muted loop playsinline width=\"100%\">\n\t\t<source src=\"");
+				md_append_asset_url(r, start_url, end_url - start_url);
+				da_append_cstr(r->out, "\" type=\"video/");
+				da_append_many(r->out, format, format_len);
+				da_append_cstr(r->out, "\" alt=\"");
+				da_append_escape_html(r->out, start_text, end_text - start_text);
+				da_append_cstr(r->out, "\">\n\t</video>\n\t<figcaption>");
+				da_append_many(r->out, start_text, end_text - start_text);
+				da_append_cstr(r->out, "\n\t</figcaption>\n</figure>\n");
+			} else {
+				da_append_cstr(r->out, "<figure>\n\t<img src=\"");
+				md_append_asset_url(r, start_url, end_url - start_url);
+				da_append_cstr(r->out, "\" loading=\"lazy\" alt=\"");
+				da_append_escape_html(r->out, start_text, end_text - start_text);
+				da_append_cstr(r->out, "\">\n\t<figcaption>");
+				da_append_many(r->out, start_text, end_text - start_text);
+				da_append_cstr(r->out, "</figcaption>\n</figure>\n");
+			}
+			p = end_url + 1;
+			continue;
+		}
+		else if (starts_with(p, "<?")) {
+			const char* tag_end = md_search(&r->code_end, p + 2, "?>");
+			if (tag_end) {
+				da_append_many(r->out, p, tag_end - p + 2);
+				p = tag_end + 2;
+				r->cursor = p;
+				// the rest is on another line
+				memset(search, 0, sizeof(search));
+				continue;
+			}
+		}
+
+		da_append(r->out, *p);
+		++p;
+	}
+}
+
+// includes newline
+void append_until_newline(StringBuilder* sb, const char* str) {
+	size_t count = 0;
+	const char* cursor = str;
+	while (*cursor && *cursor != '\n') {
+		count++;
+		cursor++;
+	}
+	da_append_many(sb, str, count + 1);
+}
+void skip_after_newline(const char** cursor) {
+	while (**cursor && **cursor != '\n') {
+		(*cursor)++;
+	}
+	if (**cursor == '\n') {
+		(*cursor)++;
+	}
+}
+
+// md_path is where relative asset urls start from, NULL keeps every url as it is
+void render_md_to_html(StringBuilder* md, StringBuilder* out, StringBuilder* out_fm, const char* md_path) {
+	MdRenderer r = { .cursor = md->items, .out = out };
+	if (md_path) {
+		const char* slash = strrchr(md_path, '/');
+		r.asset_dir = (StringView){ .items = (char*)md_path, .count = slash ? (size_t)(slash - md_path) : 0 };
+	}
+
+#define start_paragraph() if (!r.in_paragraph) { da_append_cstr(out,  "\n<p>\n"); r.in_paragraph = true; }
+#define   end_paragraph() if (r.in_paragraph)  { da_append_cstr(out, "</p>\n"); r.in_paragraph = false; }
+#define start_list() if (!r.in_list) { da_append_cstr(out,  "<ul>\n"); r.in_list = true; }
+#define   end_list() if (r.in_list)  { da_append_cstr(out, "</ul>\n"); r.in_list = false; }
+
+	while (*r.cursor) {
+		const char* line_end = r.cursor;
+		while (*line_end && *line_end != '\n') line_end++;
+
+		const char* trimmed = r.cursor;
+		while (*trimmed == ' ' || *trimmed == '\t' || *trimmed == '\r') trimmed++;
+
+		// empty line ends paragraph
+		if (line_end - trimmed == 0) {
+			end_paragraph();
+			end_list();
+
+		} else if (starts_with(trimmed, "<?")) {
+			const char* end = md_search(&r.code_end, trimmed + 2, "?>");
+			if (end) {
+				da_append_many(out, trimmed, end - trimmed + 2);
+				r.cursor = end + 2;
+				continue;
+			}
+		
+		} else if (starts_with(trimmed, "---")) {
+			if (trimmed != md->items) {
+				da_append_cstr(out, "<hr>");
+				r.cursor = trimmed + 3;
+				continue;
+			}
+
+			// frontmatter
+			const char* end = strstr(trimmed + 3, "---");
+			if (end) {
+				trimmed += 3;
+				da_append_cstr(out_fm, "<?");
+				da_append_many(out_fm, trimmed, end - trimmed);
+				da_append_cstr(out_fm, "?>\n");
+				r.cursor = end + 3;
+				continue;
+			}
+
+		// HTML passthrough
+		} else if (*trimmed == '<') {
+			end_paragraph();
+			end_list();
+
+			const char* html_end_start = search_str_until_newline(trimmed, "</");
+			const char* html_end_end   = search_str_until_newline(html_end_start, ">");
+			if (!html_end_start || !html_end_end) {
+				append_until_newline(out, trimmed);
+			} else {
+				html_end_end++;
+				da_append_many(out, trimmed, html_end_end - trimmed);
+				r.cursor = html_end_end;
+				parse_inline(&r, html_end_end);
+			}
+
+		} else if (*trimmed == '#') {
+			end_paragraph();
+			end_list();
+
+			int level = 0;
+			while (*trimmed == '#') { level++; trimmed++; }
+			while (*trimmed == ' ') trimmed++;
+
+			char tag[16];
+			sprintf(tag, "h%d", level);
+			da_append_cstr(out, "\n<"); da_append_cstr(out, tag); da_append(out, '>');
+			parse_inline(&r, trimmed);
+			da_append_cstr(out, "</"); da_append_cstr(out, tag); da_append_cstr(out, ">\n");
+
+		} else if (starts_with(trimmed, "- [ ] ")) {
+			end_paragraph();
+			end_list();
+			da_append_cstr(out, "<ul><li><input type=\"checkbox\" disabled>");
+			parse_inline(&r, trimmed + 6);
+			da_append_cstr(out, "</li></ul>\n");
+
+		} else if (starts_with(trimmed, "- ") || starts_with(trimmed, "* ")) {
+			end_paragraph();
+			start_list();
+			da_append_cstr(out, "<li>");
+			parse_inline(&r, trimmed + 2);
+			da_append_cstr(out, "</li>\n");
+
+		} else if (starts_with(trimmed, "> ")) {
+			end_paragraph();
+			end_list();
+			da_append_cstr(out, "<blockquote>");
+			parse_inline(&r, trimmed + 2);
+			da_append_cstr(out, "</blockquote>\n");
+
+		} else if (starts_with(trimmed, "```")) {
+			if (trimmed == md->items) {
+				// frontmatter
+				const char* start = trimmed;
+				skip_after_newline(&start);
+				const char* end = strstr(start, "```");
+				if (end) {
+					trimmed = start;
+					da_append_cstr(out_fm, "<?");
+					da_append_many(out_fm, trimmed, end - trimmed);
+					da_append_cstr(out_fm, "?>\n");
+					r.cursor = end + 3;
+					continue;
+				}
+			}
+
+			end_paragraph();
+			end_list();
+
+			skip_after_newline(&trimmed); // skip language
+			const char* code_end = strstr(trimmed, "```");
+			const char* md_end = md->items + md->count;
+			if (md->count > 0 && md_end[-1] == '\0') md_end--;
+
+			da_append_cstr(out, "<pre><code>\n");
+			da_append_escape_html(out, trimmed, (code_end ? code_end : md_end) - trimmed);
+			da_append_cstr(out, "</code></pre>\n");
+
+			r.cursor = code_end ? code_end + 3 : md_end;
+			continue;
+
+		} else if (starts_with(trimmed, "![")) {
+			// figure
+			end_paragraph();
+			parse_inline(&r, trimmed);
+
+		} else {
+			end_list();
+			start_paragraph();
+			parse_inline(&r, trimmed);
+			da_append(out, '\n');
+		}
+
+		if (r.cursor > line_end) continue;
+		r.cursor = (*line_end == '\n') ? line_end + 1 : line_end;
+	}
+
+	end_paragraph();
+	end_list();
+
+	if (out->count)    da_append(out, '\0');
+	if (out_fm->count) da_append(out_fm, '\0');
+
+#undef start_paragraph
+#undef   end_paragraph
+#undef start_list
+#undef   end_list
+}
+
+
+// ------------------- /md2html/ ------------------------
+
+
+typedef struct {
+	char* name;
+	char* path;
+	StringBuilder rendered_code;
+	StringBuilder html; // definitions of the html chunks used by rendered_code
+	size_t html_size;   // bytes of static html
+	size_t html_saved;  // by --minify
+	bool is_include;
+
+	uint64_t hash;
+	StringBuilder includes; // space separated INCLUDE() names, "*" for dynamic ones
+	bool changed;
+} MiteTemplate;
+
+typedef struct {
+	char* name;
+	char* md_path;
+	char* final_html_path;
+
+	StringBuilder rendered_code;
+	StringBuilder html;
+	size_t html_size;
+	size_t html_saved;
+	StringBuilder front_matter;
+	uint64_t output_size;   // of the last build, a size hint for the second stage
+	uint64_t render_start;  // --timings of render_page
+	uint64_t render_ns;
+	size_t render_worker;
+
+	// build cache
+	uint64_t md_mtime;
+	uint64_t md_size;
+	uint64_t md_hash;
+	uint64_t fm_hash;
+	StringBuilder deps;     // layout ("-" for none, "*" unknown) followed by the INCLUDE() names of the body
+	StringBuilder output;   // output path if known from the front matter, empty otherwise
+	bool rendered;          // rendered_code and front_matter are up to date
+	bool unchanged;         // the watcher saw no change since the cached build, skips the stat
+	bool changed;           // source differs from the cached build
+	bool dirty;             // needs to be rendered by the second stage
+} MitePage;
+
+typedef struct {
+	MitePage* items;
+	size_t count;
+	size_t capacity;
+} MitePages;
+
+typedef struct {
+	MiteTemplate* items;
+	size_t count;
+	size_t capacity;
+} MiteTemplates;
+
+
+static inline StringView sv_trim(StringView input) {
+	StringView sv = input;
+
+	int l = 0;
+	while (l < sv.count && (sv.items[l] == ' ' || sv.items[l] == '\t' || sv.items[l] == '\n' || sv.items[l] == '\r')) l++;
+
+	sv.items += l;
+	sv.count -= l;
+
+	int r = sv.count - 1;
+	while (r >= 0 && (sv.items[r] == ' ' || sv.items[r] == '\t' || sv.items[r] == '\n' || sv.items[r] == '\r')) r--;
+
+	sv.count = r + 1;
+
+	return sv;
+}
+static inline StringView sv_trim_empty_lines(StringView input) {
+	StringView sv = input;
+
+	int empty = 0;
+	while (empty < sv.count && (sv.items[empty] == ' ' || sv.items[empty] == '\t')) empty++;
+
+	if (empty+1 < sv.count && sv.items[empty+1] == '\n') {
+		sv.items += empty;
+		sv.count -= empty;
+	}
+
+	int r = sv.count - 1;
+	while (r >= 0 && (sv.items[r] == ' ' || sv.items[r] == '\t' || sv.items[r] == '\n' || sv.items[r] == '\r')) r--;
+	sv.count = r + 1;
+
+	return sv;
+}
+
+static inline StringView chop_until(StringView* input, const char* delim, const size_t delim_count) {
+    StringView line = {0};
+    if (!input || !delim)  return line;
+    if (input->count == 0) return line;
+    if (delim_count == 0)  return line;
+    if (input->count < delim_count) return line;
+
+	size_t i = 0;
+	while (i < input->count) {
+		size_t equal = 0;
+		for (size_t d = 0; d < delim_count; ++d) {
+			if (i+d >= input->count) break;
+			if (input->items[i+d] == delim[d]) equal++;
+		}
+		if (equal == delim_count) break;
+		++i;
+	}
+
+	line.items = input->items;
+	line.count = i;
+
+	if (i == input->count) {
+		input->items += input->count;
+		input->count = 0;
+	} else {
+		input->items += i + delim_count;
+		input->count -= i + delim_count;
+	}
+
+	return line;
+}
+
+
+void sv_to_c_code(StringView sv, StringBuilder* out) {
+	da_append_many(out, sv.items, sv.count);
+	da_append(out, '\n');
+}
+
+// appends sv as the contents of a C string literal, only what has to be is escaped
+void sv_to_c_string(StringView sv, StringBuilder* out) {
+	for (size_t i = 0; i < sv.count; ++i) {
+		unsigned char c = (unsigned char)sv.items[i];
+		switch (c) {
+			case '\\': da_append_many(out, "\\\\", 2); break;
+			case '"':  da_append_many(out, "\\\"", 2); break;
+			case '\n': da_append_many(out, "\\n", 2);  break;
+			case '\t': da_append_many(out, "\\t", 2);  break;
+			case '\r': da_append_many(out, "\\r", 2);  break;
+			case '?':
+				// no trigraphs
+				if (i + 1 < sv.count && sv.items[i+1] == '?') da_append_many(out, "?\\", 2);
+				else da_append(out, '?');
+				break;
+			default:
+				if (c < 0x20 || c == 0x7f) {
+					// octal escapes end after three digits, unlike \x
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\%03o", c);
+					da_append_many(out, buffer, 4);
+				} else {
+					da_append(out, (char)c);
+				}
+				break;
+		}
+	}
+}
+
+// ------------------- minify ---------------------------
+// --minify collapses the whitespace of static html while it is converted to C,
+// so the smaller pages cost nothing at render time
+static bool g_minify_html;
+
+typedef struct {
+	StringBuilder buffer;
+	const char* preserve;   // end of the element or comment whose content is kept as is
+	const char* opening;    // preserved element of the tag being read
+	bool in_tag;
+	char quote;             // attribute values are kept as is
+	size_t before;
+	size_t after;
+} HtmlMinify;
+
+static const char* html_preserved_tags[][2] = {
+	{ "pre", "</pre" }, { "code", "</code" }, { "textarea", "</textarea" },
+	{ "script", "</script" }, { "style", "</style" },
+};
+
+static inline bool html_match_at(StringView html, size_t i, const char* prefix) {
+	size_t len = strlen(prefix);
+	if (i + len > html.count) return false;
+	for (size_t k = 0; k < len; ++k) {
+		if (tolower((unsigned char)html.items[i + k]) != prefix[k]) return false;
+	}
+	return true;
+}
+
+static inline bool html_tag_at(StringView html, size_t i, const char* tag) {
+	size_t end = i + strlen(tag);
+	if (!html_match_at(html, i, tag)) return false;
+	return end == html.count || html.items[end] == '>' || html.items[end] == '/' || isspace((unsigned char)html.items[end]);
+}
+
+// every whitespace run outside of preserved elements becomes one newline if it had one, one space otherwise
+// the state carries over to the next chunk of the same source, chunks may end inside a tag
+StringView minify_html(StringView html, HtmlMinify* m) {
+	m->buffer.count = 0;
+	da_reserve(&m->buffer, html.count);
+	size_t i = 0;
+	while (i < html.count) {
+		char c = html.items[i];
+		if (m->preserve) {
+			if (html_match_at(html, i, m->preserve)) {
+				size_t len = strlen(m->preserve);
+				da_append_many(&m->buffer, html.items + i, len);
+				i += len;
+				m->in_tag = m->preserve[0] == '<';
+				m->preserve = NULL;
+			} else {
+				da_append(&m->buffer, c);
+				i++;
+			}
+			continue;
+		}
+		if (m->quote) {
+			if (c == m->quote) m->quote = 0;
+			da_append(&m->buffer, c);
+			i++;
+			continue;
+		}
+
+		if (isspace((unsigned char)c)) {
+			bool newline = false;
+			while (i < html.count && isspace((unsigned char)html.items[i])) newline |= html.items[i++] == '\n';
+			da_append(&m->buffer, newline && !m->in_tag ? '\n' : ' ');
+			continue;
+		}
+
+		if (m->in_tag) {
+			if (c == '"' || c == '\'') m->quote = c;
+			if (c == '>') {
+				m->in_tag = false;
+				bool self_closing = m->buffer.count && m->buffer.items[m->buffer.count - 1] == '/';
+				if (m->opening && !self_closing) m->preserve = m->opening;
+				m->opening = NULL;
+			}
+		} else if (c == '<' && html_match_at(html, i, "<!--")) {
+			m->preserve = "-->";
+			da_append_many(&m->buffer, "<!--", 4);
+			i += 4;
+			continue;
+		} else if (c == '<' && i + 1 < html.count && (isalpha((unsigned char)html.items[i + 1]) || html.items[i + 1] == '/' || html.items[i + 1] == '!')) {
+			m->in_tag = true;
+			m->opening = NULL;
+			for (size_t t = 0; t < sizeof(html_preserved_tags) / sizeof(html_preserved_tags[0]); ++t) {
+				if (html_tag_at(html, i + 1, html_preserved_tags[t][0])) m->opening = html_preserved_tags[t][1];
+			}
+		}
+		da_append(&m->buffer, c);
+		i++;
+	}
+	m->before += html.count;
+	m->after += m->buffer.count;
+	return SB_TO_SV(&m->buffer);
+}
+
+// writes the html as OUT_HTML() of a static chunk named by its hash, defined in `chunks`,
+// or as OUT_HTML() of a literal when there is nowhere to put the definition
+// returns the number of html bytes it writes out
+size_t html_to_c_code(StringView html, StringBuilder* out, StringBuilder* chunks) {
+	for (size_t i = 0; i < html.count; ++i) {
+		if (html.items[i] == '\0') html.count = i;
+	}
+	if (html.count == 0) return 0;
+	if (html.count == 1 && html.items[0] == '\n') return 0;
+
+	char buffer[64];
+	if (!chunks) {
+		da_append_cstr(out, "OUT_HTML(\"");
+		sv_to_c_string(html, out);
+		snprintf(buffer, sizeof(buffer), "\", %d)\n", (int)html.count);
+		da_append_cstr(out, buffer);
+		return html.count;
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "mite_html_%016llx_%d", (unsigned long long)hash_bytes(html.items, html.count), (int)html.count);
+	da_append_cstr(out, "OUT_HTML(");
+	da_append_cstr(out, name);
+	snprintf(buffer, sizeof(buffer), ", %d)\n", (int)html.count);
+	da_append_cstr(out, buffer);
+
+	// one line per chunk, codegen_html_chunks relies on it
+	da_append_cstr(chunks, "static const char ");
+	da_append_cstr(chunks, name);
+	da_append_cstr(chunks, "[] = \"");
+	sv_to_c_string(html, chunks);
+	da_append_cstr(chunks, "\";\n");
+	return html.count;
+}
+
+
+// NOTE: source must be null terminated
+// the static html chunks are defined in `chunks`, or written inline when it is NULL
+// the static html is minified first with `minify`, its counts add up over the calls
+// returns the size of the static html
+size_t render_html_to_c(StringView source, StringBuilder* out, StringBuilder* chunks, HtmlMinify* minify) {
+	size_t html_size = 0;
+	bool html_mode = true;
+	if (minify) {
+		minify->preserve = minify->opening = NULL;
+		minify->in_tag = false;
+		minify->quote = 0;
+	}
+	while (source.count && source.items[0]) {
+		if (html_mode) {
+			StringView token = sv_trim_empty_lines(chop_until(&source, "<?", 2));
+			if (minify) token = minify_html(token, minify);
+			html_size += html_to_c_code(token, out, chunks);
+		} else {
+			StringView token = sv_trim(chop_until(&source, "?>", 2));
+			sv_to_c_code(token, out);
+		}
+		html_mode = !html_mode;
+	}
+	return html_size;
+}
+
+// finds `lhs = value;` in generated front matter code
+// literal values are stored in `value`, conflicting assignments count as dynamic
+typedef enum {
+	ASSIGN_NONE = 0,
+	ASSIGN_LITERAL,
+	ASSIGN_NULL,
+	ASSIGN_DYNAMIC,
+} AssignKind;
+
+static inline bool is_ident_char(char c) {
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+// true if the statement at `at` always runs: it is outside of any block and follows the end
+// of another statement, so `if (x) page->layout = "a";` or `else { ... }` are not
+static inline bool is_top_level_statement(StringView code, size_t at) {
+	int depth = 0;
+	char last = ';';
+	for (size_t i = 0; i < at; ++i) {
+		char c = code.items[i];
+		if (c == '/' && i + 1 < at && code.items[i+1] == '/') {
+			while (i < at && code.items[i] != '\n') i++;
+		} else if (c == '/' && i + 1 < at && code.items[i+1] == '*') {
+			i += 2;
+			while (i + 1 < at && !(code.items[i] == '*' && code.items[i+1] == '/')) i++;
+			i++;
+		} else if (c == '"' || c == '\'') {
+			for (i++; i < at && code.items[i] != c; ++i) if (code.items[i] == '\\') i++;
+			last = c;
+		} else if (!isspace((unsigned char)c)) {
+			if (c == '{') depth++;
+			if (c == '}') depth--;
+			last = c;
+		}
+	}
+	return depth == 0 && (last == ';' || last == '}');
+}
+
+AssignKind scan_assignment(StringView code, const char* lhs, StringView* value) {
+	AssignKind kind = ASSIGN_NONE;
+	StringView needle = { .items = (char*)lhs, .count = strlen(lhs) };
+	size_t i = 0;
+	while (i < code.count) {
+		StringView rest = { .items = code.items + i, .count = code.count - i };
+		size_t at = sv_strstr(rest, needle);
+		if (at == rest.count) break;
+		i += at + needle.count;
+		if (i - needle.count > 0 && is_ident_char(code.items[i - needle.count - 1])) continue;
+
+		size_t c = i;
+		while (c < code.count && isspace((unsigned char)code.items[c])) c++;
+		if (c >= code.count || code.items[c] != '=') continue;
+		if (c + 1 < code.count && code.items[c+1] == '=') continue;
+		c++;
+		while (c < code.count && isspace((unsigned char)code.items[c])) c++;
+
+		AssignKind this_kind = ASSIGN_DYNAMIC;
+		StringView this_value = {0};
+		// conditional assignments are only known at runtime
+		bool top = is_top_level_statement(code, i - needle.count);
+		if (top && c < code.count && code.items[c] == '"') {
+			size_t end = c + 1;
+			while (end < code.count && code.items[end] != '"' && code.items[end] != '\\' && code.items[end] != '\n') end++;
+			size_t semi = end + 1;
+			while (semi < code.count && (code.items[semi] == ' ' || code.items[semi] == '\t')) semi++;
+			if (end < code.count && code.items[end] == '"' && semi < code.count && code.items[semi] == ';') {
+				this_kind = ASSIGN_LITERAL;
+				this_value.items = code.items + c + 1;
+				this_value.count = end - c - 1;
+			}
+		} else if (top && c + 4 <= code.count && 0 == strncmp(code.items + c, "NULL", 4)) {
+			this_kind = ASSIGN_NULL;
+		}
+
+		if (kind == ASSIGN_NONE) {
+			kind = this_kind;
+			*value = this_value;
+		} else if (kind != this_kind || (kind == ASSIGN_LITERAL &&
+				(value->count != this_value.count || memcmp(value->items, this_value.items, value->count) != 0))) {
+			kind = ASSIGN_DYNAMIC;
+		}
+	}
+	return kind;
+}
+
+// appends the names of INCLUDE("name") calls as space separated words, "*" for non-literal names
+void scan_includes(StringView code, StringBuilder* out) {
+	StringView needle = { .items = "INCLUDE(", .count = 8 };
+	size_t i = 0;
+	while (i < code.count) {
+		StringView rest = { .items = code.items + i, .count = code.count - i };
+		size_t at = sv_strstr(rest, needle);
+		if (at == rest.count) break;
+		i += at + needle.count;
+		if (i - needle.count > 0 && is_ident_char(code.items[i - needle.count - 1])) continue;
+
+		while (i < code.count && (code.items[i] == ' ' || code.items[i] == '\t')) i++;
+		if (i >= code.count) break;
+		if (code.items[i] == '"') {
+			size_t end = i + 1;
+			while (end < code.count && code.items[end] != '"' && code.items[end] != '\n') end++;
+			if (end >= code.count || code.items[end] != '"') continue;
+			if (out->count) da_append(out, ' ');
+			da_append_many(out, code.items + i + 1, end - i - 1);
+			i = end + 1;
+		} else if (is_ident_char(code.items[i])) {
+			if (out->count) da_append(out, ' ');
+			da_append(out, '*');
+		}
+	}
+}
+
+void scan_page_output(MitePage* mp) {
+	mp->output.count = 0;
+	StringView value = {0};
+	if (ASSIGN_LITERAL == scan_assignment(SB_TO_SV(&mp->front_matter), "page->output", &value)) {
+		da_append_sv(&mp->output, &value);
+		da_append(&mp->output, '\0');
+	}
+}
+
+void scan_page_dependencies(MitePage* mp) {
+	mp->deps.count = 0;
+	StringView layout = {0};
+	switch (scan_assignment(SB_TO_SV(&mp->front_matter), "page->layout", &layout)) {
+		case ASSIGN_NONE:    da_append_cstr(&mp->deps, DEFAULT_PAGE_LAYOUT); break;
+		case ASSIGN_LITERAL: da_append_sv(&mp->deps, &layout);               break;
+		case ASSIGN_NULL:    da_append(&mp->deps, '-');                      break;
+		case ASSIGN_DYNAMIC: da_append(&mp->deps, '*');                      break;
+	}
+	scan_includes(SB_TO_SV(&mp->front_matter), &mp->deps);
+	scan_includes(SB_TO_SV(&mp->rendered_code), &mp->deps);
+	scan_page_output(mp);
+}
+
+bool render_mite_layout(MiteTemplate* mite) {
+	if (mite->rendered_code.count > 0) return true;
+
+	StringBuilder tmpl = {0};
+	MappedFile mapped;
+	if (map_file(mite->path, &mapped)) {
+		tmpl.items = mapped.data;
+		tmpl.count = mapped.size;
+	} else if (!read_entire_file(mite->path, &tmpl)) {
+		return false;
+	}
+
+	mite->hash = hash_bytes(tmpl.items, tmpl.count);
+	mite->html.count = 0;
+	HtmlMinify minify = {0};
+	mite->html_size = render_html_to_c(SB_TO_SV(&tmpl), &mite->rendered_code, &mite->html, g_minify_html ? &minify : NULL);
+	mite->html_saved = minify.before - minify.after;
+	free(minify.buffer.items);
+	mite->includes.count = 0;
+	scan_includes(SB_TO_SV(&mite->rendered_code), &mite->includes);
+
+	if (mapped.data) unmap_file(&mapped);
+	else free(tmpl.items);
+	return true;
+}
+
+// buffers of one worker, reused from page to page
+typedef struct {
+	StringBuilder md;
+	StringBuilder html;
+	StringBuilder fm;
+	HtmlMinify minify;
+} RenderScratch;
+
+bool render_page(MitePage* mite_page, RenderScratch* scratch) {
+	if (!file_exists(mite_page->md_path)) return false;
+
+	StringBuilder md = scratch->md;
+	StringBuilder raw_html = scratch->html;
+	StringBuilder raw_fm = scratch->fm;
+	md.count = raw_html.count = raw_fm.count = 0;
+
+	const char* asset_base = g_fingerprint_assets ? mite_page->md_path : NULL;
+
+	// big pages are parsed straight from the mapping
+	MappedFile mapped;
+	if (map_file(mite_page->md_path, &mapped)) {
+		mite_page->md_hash = hash_bytes(mapped.data, mapped.size);
+		StringBuilder view = { .items = mapped.data, .count = mapped.size + 1 };
+		render_md_to_html(&view, &raw_html, &raw_fm, asset_base);
+		unmap_file(&mapped);
+	} else if (read_entire_file(mite_page->md_path, &md)) {
+		mite_page->md_hash = hash_bytes(md.items, md.count);
+		da_append(&md, '\0');
+		render_md_to_html(&md, &raw_html, &raw_fm, asset_base);
+	} else {
+		scratch->md = md;
+		return false;
+	}
+	scratch->md = md;
+	scratch->html = raw_html;
+	scratch->fm = raw_fm;
+
+	if (raw_fm.count == 0) {
+		printf("[warning] page does not have any front matter! '%s'\n", mite_page->md_path+2);
+	}
+
+	mite_page->rendered_code.count = 0;
+	mite_page->front_matter.count = 0;
+	mite_page->html.count = 0;
+	HtmlMinify* minify = g_minify_html ? &scratch->minify : NULL;
+	if (minify) minify->before = minify->after = 0;
+	mite_page->html_size = render_html_to_c(SB_TO_SV(&raw_html), &mite_page->rendered_code, &mite_page->html, minify);
+	mite_page->html_saved = minify ? minify->before - minify->after : 0;
+	// the front matter of clean pages comes from the build cache, it has to stand alone
+	render_html_to_c(SB_TO_SV(&raw_fm), &mite_page->front_matter, NULL, NULL);
+
+	mite_page->fm_hash = hash_bytes(mite_page->front_matter.items, mite_page->front_matter.count);
+	scan_page_dependencies(mite_page);
+	mite_page->rendered = true;
+	return true;
+}
+
+typedef struct {
+	MiteTemplate** templates;
+	MitePage** pages;
+	bool* ok;
+	RenderScratch* scratch; // one per worker
+} RenderBatch;
+
+static void render_template_job(void* userdata, size_t index, size_t worker) {
+	(void)worker;
+	RenderBatch* batch = userdata;
+	batch->ok[index] = render_mite_layout(batch->templates[index]);
+}
+
+static void render_page_job(void* userdata, size_t index, size_t worker) {
+	RenderBatch* batch = userdata;
+	MitePage* mp = batch->pages[index];
+	uint64_t start = g_timings.enabled ? timing_now_ns() : 0;
+	batch->ok[index] = render_page(mp, &batch->scratch[worker]);
+	if (g_timings.enabled) {
+		mp->render_start = start;
+		mp->render_ns = timing_now_ns() - start;
+		mp->render_worker = worker;
+	}
+}
+
+// every template and page owns its buffers, so they can be rendered from `jobs` threads
+// in any order while the output stays the same
+void render_templates(MiteTemplates* templates, size_t jobs) {
+	RenderBatch batch = {
+		.templates = calloc(templates->count + 1, sizeof(MiteTemplate*)),
+		.ok = calloc(templates->count + 1, sizeof(bool)),
+	};
+	size_t count = 0;
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+		if (mt->rendered_code.count > 0) continue;
+		printf("[mite] %s\n", mt->path+2);
+		batch.templates[count++] = mt;
+	}
+
+	run_parallel(jobs, count, render_template_job, &batch);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (!batch.ok[i]) {
+			printf("failed to render mite layout: %s\n", batch.templates[i]->name);
+			exit(1);
+		}
+	}
+	free(batch.templates);
+	free(batch.ok);
+}
+
+// renders every dirty page that is not rendered yet
+void render_pages(MitePages* pages, size_t jobs) {
+	RenderBatch batch = {
+		.pages = calloc(pages->count + 1, sizeof(MitePage*)),
+		.ok = calloc(pages->count + 1, sizeof(bool)),
+		.scratch = calloc(jobs + 1, sizeof(RenderScratch)),
+	};
+	size_t count = 0;
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		if (mp->rendered || !mp->dirty) continue;
+		printf("[page] %s\n", mp->md_path+2);
+		batch.pages[count++] = mp;
+	}
+
+	run_parallel(jobs, count, render_page_job, &batch);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (!batch.ok[i]) {
+			printf("failed to render page: %s\n", batch.pages[i]->name);
+			exit(1);
+		}
+	}
+	for (size_t i = 0; i < jobs + 1; ++i) {
+		free(batch.scratch[i].md.items);
+		free(batch.scratch[i].html.items);
+		free(batch.scratch[i].fm.items);
+		free(batch.scratch[i].minify.buffer.items);
+	}
+	free(batch.scratch);
+	free(batch.pages);
+	free(batch.ok);
+}
+
+
+bool ends_with(const char* name, const char* ext) {
+	size_t len = strlen(name);
+	size_t ext_len = strlen(ext);
+	if (len < ext_len) return false;
+	return strcmp(name + len - ext_len, ext) == 0;
+}
+
+int is_mite_file(const char* name) {
+	return ends_with(name, ".mite");
+}
+
+int is_md_file(const char* name) {
+	return ends_with(name, ".md");
+}
+
+void join_path(char* out, const char* a, const char* b) {
+	snprintf(out, MAX_PATH_LEN*2, "%s/%s", a, b);
+}
+
+
+extern char* strdup(const char*);
+
+// source paths live in a list of fixed blocks, so pointers into it stay valid until the next scan
+#define PATH_ARENA_BLOCK (64*1024)
+
+typedef struct PathBlock {
+	struct PathBlock* next;
+	size_t count;
+	size_t capacity;
+	char items[];
+} PathBlock;
+
+typedef struct {
+	PathBlock* head;
+} PathArena;
+
+char* path_arena_alloc(PathArena* arena, size_t size) {
+	PathBlock* b = arena->head;
+	if (!b || b->capacity - b->count < size) {
+		size_t capacity = size > PATH_ARENA_BLOCK ? size : PATH_ARENA_BLOCK;
+		b = malloc(sizeof(PathBlock) + capacity);
+		b->next = arena->head;
+		b->count = 0;
+		b->capacity = capacity;
+		arena->head = b;
+	}
+	char* result = b->items + b->count;
+	b->count += size;
+	return result;
+}
+
+char* path_arena_join(PathArena* arena, const char* dir, const char* name, size_t name_len) {
+	size_t dir_len = strlen(dir);
+	char* path = path_arena_alloc(arena, dir_len + 1 + name_len + 1);
+	memcpy(path, dir, dir_len);
+	path[dir_len] = '/';
+	memcpy(path + dir_len + 1, name, name_len);
+	path[dir_len + 1 + name_len] = '\0';
+	return path;
+}
+
+char* path_arena_strdup(PathArena* arena, const char* str) {
+	size_t len = strlen(str);
+	char* result = path_arena_alloc(arena, len + 1);
+	memcpy(result, str, len + 1);
+	return result;
+}
+
+void path_arena_free(PathArena* arena) {
+	while (arena->head) {
+		PathBlock* next = arena->head->next;
+		free(arena->head);
+		arena->head = next;
+	}
+}
+
+// content directories in scan order, a directory is followed by the ones below it
+typedef struct {
+	const char* path;
+	uint64_t mtime;      // 0 if it was too recent to trust
+	size_t first_page;   // its own pages are contiguous in MitePages
+	size_t page_count;
+	size_t subtree;      // number of directories below it
+} MiteSourceDir;
+
+typedef struct {
+	MiteSourceDir* items;
+	size_t count;
+	size_t capacity;
+} MiteSourceDirs;
+
+void register_mite_file(MiteTemplates* templates, PathArena* paths, const char* mite_dir, const char* mite_name, bool is_include) {
+	da_append(templates, (MiteTemplate){0});
+	MiteTemplate* mt = &templates->items[templates->count-1];
+
+	mt->path = path_arena_join(paths, mite_dir, mite_name, strlen(mite_name));
+
+	mt->name = path_arena_strdup(paths, mite_name);
+	size_t len = strlen(mt->name);
+	if (len > 5 && strcmp(mt->name + len - 5, ".mite") == 0) {
+		mt->name[len-5] = '\0';
+	}
+
+	mt->is_include = is_include;
+}
+void register_md_file(MitePages* pages, PathArena* paths, const char* md_dir, const char* md_name, size_t md_name_len) {
+	da_append(pages, (MitePage){0});
+	MitePage* mp = &pages->items[pages->count-1];
+
+	mp->md_path = path_arena_join(paths, md_dir, md_name, md_name_len);
+
+	mp->name = path_arena_strdup(paths, mp->md_path+2);
+	size_t len = strlen(mp->name);
+	if (len > 3 && strcmp(mp->name + len - 3, ".md") == 0) {
+		len -= 3;
+	}
+	mp->name[len] = '\0';
+	for (size_t i = 0; i < len; ++i) {
+		if (!isalnum(mp->name[i])) {
+			mp->name[i] = '_';
+		}
+	}
+
+	mp->final_html_path = path_arena_join(paths, md_dir, "index.html", 10);
+}
+
+
+static inline bool sv_eq_cstr(StringView sv, const char* cstr) {
+	size_t len = strlen(cstr);
+	return sv.count == len && 0 == memcmp(sv.items, cstr, len);
+}
+
+MiteTemplate* find_mite_template(MiteTemplates* templates, StringView name) {
+	for (size_t i = 0; i < templates->count; ++i) {
+		if (sv_eq_cstr(name, templates->items[i].name)) return &templates->items[i];
+	}
+	return NULL;
+}
+
+// copies code with every INCLUDE("name") of a known include template replaced by a direct call,
+// the names it bound are appended to `bound` as space separated words
+void bind_includes(StringView code, MiteTemplates* templates, StringBuilder* out, StringBuilder* bound) {
+	StringView needle = { .items = "INCLUDE(", .count = 8 };
+	size_t copied = 0;
+	size_t i = 0;
+	while (i < code.count) {
+		StringView rest = { .items = code.items + i, .count = code.count - i };
+		size_t at = sv_strstr(rest, needle);
+		if (at == rest.count) break;
+		size_t start = i + at;
+		i = start + needle.count;
+		if (start > 0 && is_ident_char(code.items[start - 1])) continue;
+
+		while (i < code.count && (code.items[i] == ' ' || code.items[i] == '\t')) i++;
+		if (i >= code.count || code.items[i] != '"') continue;
+		size_t end = i + 1;
+		while (end < code.count && code.items[end] != '"' && code.items[end] != '\n') end++;
+		if (end >= code.count || code.items[end] != '"') continue;
+		StringView name = { .items = code.items + i + 1, .count = end - i - 1 };
+		end++;
+		while (end < code.count && (code.items[end] == ' ' || code.items[end] == '\t')) end++;
+		if (end >= code.count || code.items[end] != ')') continue;
+
+		MiteTemplate* mt = find_mite_template(templates, name);
+		if (!mt || !mt->is_include) continue;
+
+		da_append_many(out, code.items + copied, start - copied);
+		da_append_cstr(out, "INCLUDE_TEMPLATE(");
+		da_append_cstr(out, mt->name);
+		da_append(out, ')');
+		copied = i = end + 1;
+
+		if (bound) {
+			if (bound->count) da_append(bound, ' ');
+			da_append_cstr(bound, mt->name);
+		}
+	}
+	da_append_many(out, code.items + copied, code.count - copied);
+}
+
+bool check_template_names(MiteTemplates* templates, StringView names, const char* user) {
+	bool ok = true;
+	while (names.count > 0) {
+		StringView name = sv_trim(chop_until(&names, " ", 1));
+		if (name.count == 0 || sv_eq_cstr(name, "*") || sv_eq_cstr(name, "-")) continue;
+		if (find_mite_template(templates, name)) continue;
+		printf("[error] template '%.*s' not found, used by %s\n", (int)name.count, name.items, user);
+		ok = false;
+	}
+	return ok;
+}
+
+// reports missing layouts and includes with literal names,
+// instead of the second stage exiting halfway through the render
+bool check_templates_exist(MitePages* pages, MiteTemplates* templates) {
+	bool ok = true;
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+		ok &= check_template_names(templates, SB_TO_SV(&mt->includes), mt->path+2);
+	}
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		if (mp->dirty) ok &= check_template_names(templates, SB_TO_SV(&mp->deps), mp->md_path+2);
+	}
+	return ok;
+}
+
+void codegen_template_declaration(StringBuilder* out, const char* name) {
+	da_append_cstr(out, "void render_template_");
+	da_append_cstr(out, name);
+	da_append_cstr(out, "(StringBuilder* out, SitePage* page, render_content_func_t render_content_func)");
+}
+
+typedef struct {
+	uint64_t* items; // 0 is empty
+	size_t count;
+	size_t capacity; // power of two
+} MiteHashSet;
+
+// true if the hash was not in the set yet
+bool hash_set_insert(MiteHashSet* set, uint64_t hash) {
+	if (hash == 0) hash = 1;
+	if ((set->count + 1) * 2 > set->capacity) {
+		MiteHashSet grown = { .capacity = set->capacity ? set->capacity * 2 : 64 };
+		grown.items = calloc(grown.capacity, sizeof(uint64_t));
+		for (size_t i = 0; i < set->capacity; ++i) {
+			if (set->items[i]) hash_set_insert(&grown, set->items[i]);
+		}
+		free(set->items);
+		*set = grown;
+	}
+	size_t mask = set->capacity - 1;
+	size_t slot = hash & mask;
+	while (set->items[slot]) {
+		if (set->items[slot] == hash) return false;
+		slot = (slot + 1) & mask;
+	}
+	set->items[slot] = hash;
+	set->count++;
+	return true;
+}
+
+// appends the chunk definitions that are not in the translation unit yet,
+// identical html shared by several layouts and pages is emitted once
+void codegen_html_chunks(StringBuilder* out, StringBuilder* chunks, MiteHashSet* emitted) {
+	StringView rest = SB_TO_SV(chunks);
+	while (rest.count > 0) {
+		StringView line = chop_until(&rest, "\n", 1);
+		if (!hash_set_insert(emitted, hash_bytes(line.items, line.count))) continue;
+		da_append_sv(out, &line);
+		da_append(out, '\n');
+	}
+}
+
+// the generated code only includes mite.c, this line changes it, and any cache of its binary,
+// whenever mite.c or the options the site is built with change
+void codegen_source_hash(StringBuilder* out, uint64_t source_hash) {
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "// mite %016llx\n", (unsigned long long)source_hash);
+	da_append_cstr(out, buffer);
+}
+
+void second_stage_include_header(StringBuilder* out, const char* source_path) {
+	da_append_cstr(out, "#define SECOND_STAGE\n");
+#ifdef MITE_USE_BROTLI
+	da_append_cstr(out, "#define MITE_USE_BROTLI\n");
+#endif
+	da_append_cstr(out, "#include \"");
+	da_append_cstr(out, source_path);
+	da_append_cstr(out, "\"\n\n");
+}
+
+// the hashed copies of --fingerprint, the site looks them up by path
+void codegen_assets(StringBuilder* out, MiteAssets* assets) {
+	size_t count = 0;
+	da_append_cstr(out, "const SiteAsset site_assets[] = {\n");
+	for (size_t i = 0; i < assets->count; ++i) {
+		MiteAsset* a = &assets->items[i];
+		if (!a->hash) continue;
+		da_append_cstr(out, "	{ \"");
+		sv_to_c_string((StringView){ .items = a->path, .count = strlen(a->path) }, out);
+		da_append_cstr(out, "\", \"");
+		sv_to_c_string((StringView){ .items = a->url, .count = strlen(a->url) }, out);
+		da_append_cstr(out, "\" },\n");
+		count++;
+	}
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "	{ NULL, NULL },\n};\nconst size_t site_assets_count = %d;\n", (int)count);
+	da_append_cstr(out, buffer);
+}
+
+void codegen_global_variables(StringBuilder* out, MitePages* pages) {
+	da_append_cstr(out,
+		"SiteGlobal global = { .title = \"!!!global!title!!!\", .description = \"!!!global!description!!!\" };\n"
+	);
+	codegen_assets(out, &g_assets);
+
+	// main() renders through these handles instead of looking every page up by its input
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "SitePage* site_pages[%d];\n", (int)pages->count + 1);
+	da_append_cstr(out, buffer);
+}
+
+// the pages [first, last) in their order, each running its front matter
+void codegen_construct_pages(StringBuilder* out, MitePages* pages, size_t first, size_t last) {
+	char buffer[64];
+	for (size_t i = first; i < last; ++i) {
+		MitePage* mp = &pages->items[i];
+		da_append_cstr(out, "	{\n");
+
+		da_append_cstr(out, "		SitePage* page = site_page_new_tdu(\"");
+		da_append_cstr(out, mp->name);
+		da_append_cstr(out, "\", NULL, \"");
+		da_append_cstr(out, (mp->final_html_path+1)); // +1 removes the . in the path
+		da_append_cstr(out, "\");\n");
+		da_append_cstr(out, "		page->output = \"");
+		da_append_cstr(out, mp->final_html_path+2); // +2 removes ./
+		da_append_cstr(out, "\";\n");
+		da_append_cstr(out, "		page->input = \"");
+		da_append_cstr(out, mp->md_path);
+		da_append_cstr(out, "\";\n");
+
+		da_append_cstr(out, "		da_append(&global.pages, page);\n");
+		snprintf(buffer, sizeof(buffer), "		site_pages[%d] = page;\n", (int)i);
+		da_append_cstr(out, buffer);
+
+		da_append_sv(out, &mp->front_matter);
+
+		da_append_cstr(out, "	}\n");
+	}
+}
+
+void codegen_global_state(StringBuilder* out, MitePages* pages) {
+	codegen_global_variables(out, pages);
+	da_append_cstr(out,
+		"void construct_global_state(void) {\n"
+	);
+	codegen_construct_pages(out, pages, 0, pages->count);
+	da_append_cstr(out,
+		"}\n"
+	);
+}
+
+void codegen_templates(StringBuilder* out, MiteTemplates* templates) {
+	for (size_t i = 0; i < templates->count; ++i) {
+		codegen_template_declaration(out, templates->items[i].name);
+		da_append_cstr(out, ";\n");
+	}
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+
+		codegen_template_declaration(out, mt->name);
+		da_append_cstr(out, " {\n");
+
+		bind_includes(SB_TO_SV(&mt->rendered_code), templates, out, NULL);
+
+		da_append_cstr(out, "}\n");
+	}
+
+
+	da_append_cstr(out,
+		"void construct_templates(void) {\n"
+	);
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+
+		da_append_cstr(out,
+			"	{\n"
+			"		da_append(&global.templates, (SiteTemplate){0});\n"
+			"		SiteTemplate* st = &global.templates.items[global.templates.count-1];\n"
+			"		st->name = \""
+		);
+		da_append_cstr(out, mt->name);
+		da_append_cstr(out, "\";\n"
+			"		st->function = render_template_"
+		);
+		da_append_cstr(out, mt->name);
+		da_append_cstr(out, ";\n"
+			"		st->is_include = "
+		);
+		da_append_cstr(out, mt->is_include ? "1": "0");
+		da_append_cstr(out, ";\n\t}\n");
+	}
+	da_append_cstr(out,
+		"	site_templates_index(&global.templates);\n"
+		"}\n"
+	);
+}
+
+void codegen_page_declaration(StringBuilder* out, MitePage* mp) {
+	da_append_cstr(out, "void render_");
+	da_append_cstr(out, mp->name);
+	da_append_cstr(out, "(StringBuilder* out, SitePage* page)");
+}
+
+void codegen_page(StringBuilder* out, MitePage* mp, MiteTemplates* templates) {
+	StringBuilder body = {0};
+	StringBuilder bound = {0};
+	bind_includes(SB_TO_SV(&mp->rendered_code), templates, &body, &bound);
+
+	// the templates may live in another translation unit with --split
+	StringView names = SB_TO_SV(&bound);
+	while (names.count > 0) {
+		StringView name = chop_until(&names, " ", 1);
+		da_append_cstr(out, "void render_template_");
+		da_append_sv(out, &name);
+		da_append_cstr(out, "(StringBuilder* out, SitePage* page, render_content_func_t render_content_func);\n");
+	}
+
+	codegen_page_declaration(out, mp);
+	da_append_cstr(out, " {\n");
+	da_append_cstr(out, "	render_content_func_t render_content_func = NULL;\n");
+
+
+	da_append_sv(out, &body);
+
+	da_append_cstr(out, "}\n");
+	free(body.items);
+	free(bound.items);
+}
+
+typedef struct {
+	StringView name; // sort_pages or sort_pages_alt
+	StringView arg;  // trimmed
+	const char* kind;
+} SortCall;
+
+// finds the next call of sort_pages() or sort_pages_alt() in code from *at on
+bool next_sort_call(StringView code, size_t* at, SortCall* call) {
+	static const char* sorts[] = { "sort_pages(", "sort_pages_alt(" };
+	static const char* kinds[] = { "SITE_SORT_DATE", "SITE_SORT_DATE_ALT" };
+	for (size_t i = *at; i < code.count; ++i) {
+		if (i > 0 && is_ident_char(code.items[i-1])) continue;
+		for (size_t s = 0; s < sizeof(sorts)/sizeof(sorts[0]); ++s) {
+			size_t len = strlen(sorts[s]);
+			if (i + len > code.count || 0 != memcmp(code.items + i, sorts[s], len)) continue;
+
+			size_t end = i + len;
+			int depth = 1;
+			for (; end < code.count && depth > 0; ++end) {
+				if (code.items[end] == '(') depth++;
+				if (code.items[end] == ')') depth--;
+			}
+			if (depth > 0) return false;
+			*call = (SortCall){
+				.name = { .items = code.items + i, .count = len - 1 },
+				.arg = sv_trim((StringView){ .items = code.items + i + len, .count = end - 1 - (i + len) }),
+				.kind = kinds[s],
+			};
+			*at = end;
+			return true;
+		}
+	}
+	return false;
+}
+
+// `&global.x`, the collections prepare_global_state sorts before the threads start
+static inline bool sort_call_is_global(SortCall* call) {
+	if (call->arg.count <= 8 || 0 != strncmp(call->arg.items, "&global.", 8)) return false;
+	for (size_t i = 8; i < call->arg.count; ++i) {
+		if (!is_ident_char(call->arg.items[i]) && call->arg.items[i] != '.') return false;
+	}
+	return true;
+}
+
+// appends `site_hoist_sort(&global.x, kind);` for every sort of a global collection found in code
+void scan_global_sorts(StringView code, StringBuilder* out) {
+	size_t at = 0;
+	SortCall call;
+	while (next_sort_call(code, &at, &call)) {
+		if (!sort_call_is_global(&call)) continue;
+		StringBuilder statement = {0};
+		da_append_cstr(&statement, "\tsite_hoist_sort(");
+		da_append_sv(&statement, &call.arg);
+		da_append_cstr(&statement, ", ");
+		da_append_cstr(&statement, call.kind);
+		da_append_cstr(&statement, ");\n");
+		if (sv_strstr(SB_TO_SV(out), SB_TO_SV(&statement)) == out->count) da_append_sv(out, &statement);
+		free(statement.items);
+	}
+}
+
+typedef struct {
+	SortCall* items;
+	size_t count;
+	size_t capacity;
+} SortCalls;
+
+// the sorts of one source, for check_parallel_sorts. `sorted` holds the global sorts seen so far
+static bool check_sorts_of(StringView code, const char* path, SortCalls* sorted, bool report) {
+	bool ok = true;
+	size_t at = 0;
+	SortCall call;
+	while (next_sort_call(code, &at, &call)) {
+		// tag lists are kept newest first, sort_pages leaves them as they are
+		if (sv_eq_cstr(call.name, "sort_pages") && 0 == strncmp(call.arg.items, "TAG_PAGES(", 10)) continue;
+		if (!sort_call_is_global(&call)) {
+			if (report) printf("[warning] %s: %.*s(%.*s) can not run before the threads start\n",
+				path, (int)call.name.count, call.name.items, (int)call.arg.count, call.arg.items);
+			ok = false;
+			continue;
+		}
+		bool seen = false;
+		for (size_t i = 0; i < sorted->count && !seen; ++i) {
+			SortCall* other = &sorted->items[i];
+			if (other->arg.count != call.arg.count || 0 != memcmp(other->arg.items, call.arg.items, call.arg.count)) continue;
+			seen = true;
+			if (other->kind == call.kind) continue;
+			if (report) printf("[warning] %s: %.*s is sorted by both sort_pages and sort_pages_alt\n",
+				path, (int)call.arg.count - 1, call.arg.items + 1);
+			ok = false;
+		}
+		if (!seen) da_append(sorted, call);
+	}
+	return ok;
+}
+
+// -j renders the pages at the same time, which only works if every sort found in the templates
+// and the rendered pages is of a global collection, by one kind, so prepare_global_state can run
+// it before the threads start. the site renders on one thread otherwise
+bool check_parallel_sorts(MitePages* pages, MiteTemplates* templates, bool report) {
+	SortCalls sorted = {0};
+	bool ok = true;
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+		if (!check_sorts_of(SB_TO_SV(&mt->rendered_code), mt->path, &sorted, report)) ok = false;
+	}
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		if (!mp->dirty) continue;
+		if (!check_sorts_of(SB_TO_SV(&mp->rendered_code), mp->md_path + 2, &sorted, report)) ok = false;
+	}
+	if (!ok && report) printf("[warning] rendering on one thread\n");
+	free(sorted.items);
+	return ok;
+}
+
+// the layout is the first word of deps
+StringView page_layout_name(MitePage* mp) {
+	StringView deps = SB_TO_SV(&mp->deps);
+	return chop_until(&deps, " ", 1);
+}
+
+// the last output, or at least the static html of the page and its layout
+size_t page_size_hint(MitePage* mp, MiteTemplate* layout) {
+	size_t size_hint = mp->html_size + (layout ? layout->html_size : 0);
+	if (mp->output_size > size_hint) size_hint = (size_t)mp->output_size;
+	// rounded up, small edits keep the --split main unit cached
+	size_t rounded = 1024;
+	while (rounded < size_hint) rounded *= 2;
+	return size_hint ? rounded : 0;
+}
+
+void codegen_main(StringBuilder* out, MitePages* pages, MiteTemplates* templates) {
+	StringBuilder sorts = {0};
+	for (size_t i = 0; i < templates->count; ++i) {
+		scan_global_sorts(SB_TO_SV(&templates->items[i].rendered_code), &sorts);
+	}
+	for (size_t i = 0; i < pages->count; ++i) {
+		if (pages->items[i].dirty) scan_global_sorts(SB_TO_SV(&pages->items[i].rendered_code), &sorts);
+	}
+	da_append_cstr(out, "void prepare_global_state(void) {\n");
+	da_append_sv(out, &sorts);
+	da_append_cstr(out, "}\n");
+	free(sorts.items);
+
+	da_append_cstr(out,
+		"int main(int argc, char** argv) {\n"
+		"	construct_global_state();\n"
+		"	site_parse_dates(&global.pages);\n"
+		"	site_index_tags(&global.tags, &global.pages);\n"
+		"	construct_templates();\n"
+		"	size_t threads = site_threads_from_args(argc, argv);\n"
+	);
+	// sorts that can not run before the threads start, see check_parallel_sorts
+	if (g_render_serial) da_append_cstr(out, "	threads = 1;\n");
+	da_append_cstr(out,
+		"	if (threads > 1) prepare_global_state();\n\n"
+		"	SiteRenderJob jobs[] = {\n"
+	);
+
+	size_t count = 0;
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		if (!mp->dirty) continue;
+
+		char handle[64];
+		snprintf(handle, sizeof(handle), "		{ site_pages[%d], render_", (int)i);
+		da_append_cstr(out, handle);
+		da_append_cstr(out, mp->name);
+
+		StringView layout = page_layout_name(mp);
+		MiteTemplate* mt = find_mite_template(templates, layout);
+		if (mt) {
+			da_append_cstr(out, ", render_template_");
+			da_append_cstr(out, mt->name);
+			da_append_cstr(out, ", 1");
+		} else if (sv_eq_cstr(layout, "-")) {
+			da_append_cstr(out, ", NULL, 1");
+		} else {
+			da_append_cstr(out, ", NULL, 0");
+		}
+
+		snprintf(handle, sizeof(handle), ", %d", (int)page_size_hint(mp, mt));
+		da_append_cstr(out, handle);
+		if (mt) {
+			da_append_cstr(out, ", \"");
+			da_append_cstr(out, mt->name);
+			da_append_cstr(out, "\" },\n");
+		} else {
+			da_append_cstr(out, " },\n");
+		}
+		count++;
+	}
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "	};\n	site_render(jobs, %d, threads, site_timings_from_args(argc, argv),\n		site_compress_from_args(argc, argv), site_stream_from_args(argc, argv));\n", (int)count);
+	da_append_cstr(out, buffer);
+	da_append_cstr(out,
+		"	return 0;\n"
+		"}"
+	);
+}
+
+void second_stage_codegen(StringBuilder* out, MitePages* pages, MiteTemplates* templates) {
+	MiteHashSet emitted = {0};
+	for (size_t i = 0; i < templates->count; ++i) {
+		codegen_html_chunks(out, &templates->items[i].html, &emitted);
+	}
+	for (size_t i = 0; i < pages->count; ++i) {
+		if (pages->items[i].dirty) codegen_html_chunks(out, &pages->items[i].html, &emitted);
+	}
+	free(emitted.items);
+
+	codegen_global_state(out, pages);
+	codegen_templates(out, templates);
+	for (size_t i = 0; i < pages->count; ++i) {
+		if (pages->items[i].dirty) codegen_page(out, &pages->items[i], templates);
+	}
+	codegen_main(out, pages, templates);
+}
+
+// ------------------- split build ----------------------
+// --split emits one translation unit per page next to a shared one with the
+// templates and main(), the global state and the front matter of groups of
+// MITE_SPLIT_GROUP_PAGES pages get their own. objects are cached in MITE_BUILD_DIR
+// by the hash of their translation unit, so unchanged pages are never recompiled
+#define MITE_OBJECT_INDEX_PATH MITE_BUILD_DIR"/objects"
+#define MITE_SPLIT_GROUP_PAGES 128
+
+#ifndef _WIN32
+	#define MITE_HOT_RELOAD
+	#define MITE_HOST_BINARY MITE_BUILD_DIR"/site_host"
+	#define MITE_HOST_LINK_ARGS_PATH MITE_BUILD_DIR"/host_link_args"
+#endif
+#ifdef __APPLE__
+	#define MITE_MODULE_FLAGS " -fPIC -shared -undefined dynamic_lookup"
+#else
+	#define MITE_MODULE_FLAGS " -fPIC -shared"
+#endif
+
+// the running host of --daemon, see site_host
+typedef struct {
+	FILE* commands; // its stdin
+	int replies;
+	bool running;
+} MiteHost;
+#define MITE_LINK_ARGS_PATH MITE_BUILD_DIR"/link_args"
+
+typedef struct {
+	char* name;
+	uint64_t hash;
+	bool used;
+} MiteObject;
+
+typedef struct {
+	MiteObject* items;
+	size_t count;
+	size_t capacity;
+} MiteObjects;
+
+void load_object_index(MiteObjects* objects) {
+	StringBuilder sb = {0};
+	if (!file_exists(MITE_OBJECT_INDEX_PATH) || !read_entire_file(MITE_OBJECT_INDEX_PATH, &sb)) return;
+	da_append(&sb, '\0');
+
+	char* cursor = sb.items;
+	while (*cursor) {
+		unsigned long long hash;
+		char name[MAX_PATH_LEN];
+		int n = 0;
+		char* line_end = strchr(cursor, '\n');
+		if (line_end) *line_end = '\0';
+		if (2 != sscanf(cursor, "%llx %1023s%n", &hash, name, &n) || n == 0) break;
+		da_append(objects, ((MiteObject){ .name = strdup(name), .hash = hash }));
+		cursor += n;
+		if (line_end) cursor = line_end + 1;
+		while (*cursor == '\n' || *cursor == '\r') cursor++;
+	}
+	free(sb.items);
+}
+
+void save_object_index(MiteObjects* objects) {
+	StringBuilder sb = {0};
+	char buffer[32];
+	for (size_t i = 0; i < objects->count; ++i) {
+		snprintf(buffer, sizeof(buffer), "%016llx ", (unsigned long long)objects->items[i].hash);
+		da_append_cstr(&sb, buffer);
+		da_append_cstr(&sb, objects->items[i].name);
+		da_append(&sb, '\n');
+	}
+	write_to_file(MITE_OBJECT_INDEX_PATH, &sb);
+	free(sb.items);
+}
 
-			// frontmatter
-			const char* end = strstr(trimmed + 3, "---");
-			if (end) {
-				trimmed += 3;
-				da_append_cstr(out_fm, "<?");
-				da_append_many(out_fm, trimmed, end - trimmed);
-				da_append_cstr(out_fm, "?>\n");
-				r.cursor = end + 3;
-				continue;
-			}
+MiteObject* find_object(MiteObjects* objects, const char* name) {
+	for (size_t i = 0; i < objects->count; ++i) {
+		if (0 == strcmp(objects->items[i].name, name)) return &objects->items[i];
+	}
+	return NULL;
+}
 
-		// HTML passthrough
-		} else if (*trimmed == '<') {
-			end_paragraph();
-			end_list();
+void split_include_header(StringBuilder* out, const char* source_path, uint64_t source_hash) {
+	codegen_source_hash(out, source_hash);
+	da_append_cstr(out, "#define SITE_SHARED_ARENAS\n");
 
-			const char* html_end_start = search_str_until_newline(trimmed, "</");
-			const char* html_end_end   = search_str_until_newline(html_end_start, ">");
-			if (!html_end_start || !html_end_end) {
-				append_until_newline(out, trimmed);
-			} else {
-				html_end_end++;
-				da_append_many(out, trimmed, html_end_end - trimmed);
-				r.cursor = html_end_end;
-				parse_inline(&r, html_end_end);
-			}
+	// translation units live in MITE_BUILD_DIR
+	bool relative = source_path[0] != '/' && source_path[0] != '\\' && !(source_path[0] && source_path[1] == ':');
+	if (!relative) {
+		second_stage_include_header(out, source_path);
+		return;
+	}
+	StringBuilder path = {0};
+	da_append_cstr(&path, "../");
+	da_append_cstr(&path, source_path);
+	da_append(&path, '\0');
+	second_stage_include_header(out, path.items);
+	free(path.items);
+}
 
-		} else if (*trimmed == '#') {
-			end_paragraph();
-			end_list();
+// modules are the shared objects of --daemon, named by their hash so the host never
+// mistakes a rebuilt one for the one it loaded
+void split_unit_path(char* out, size_t size, const char* name, uint64_t hash, bool module) {
+	if (module) snprintf(out, size, MITE_BUILD_DIR"/%s-%016llx.so", name, (unsigned long long)hash);
+	else        snprintf(out, size, MITE_BUILD_DIR"/%s.o", name);
+}
 
-			int level = 0;
-			while (*trimmed == '#') { level++; trimmed++; }
-			while (*trimmed == ' ') trimmed++;
+// writes the translation unit and queues its compilation, unless its object is cached,
+// returns the hash of the unit
+uint64_t split_add_unit(MiteObjects* objects, const char* name, StringBuilder* code, bool module,
+						StringBuilder* link_args, StringBuilder* commands, MiteObjects* compiled) {
+	uint64_t hash = hash_bytes(code->items, code->count);
+	char c_path[MAX_PATH_LEN];
+	char o_path[MAX_PATH_LEN];
+	snprintf(c_path, sizeof(c_path), MITE_BUILD_DIR"/%s.c", name);
+	split_unit_path(o_path, sizeof(o_path), name, hash, module);
+
+	if (link_args) {
+		da_append_cstr(link_args, o_path);
+		da_append(link_args, '\n');
+	}
 
-			char tag[16];
-			sprintf(tag, "h%d", level);
-			da_append_cstr(out, "\n<"); da_append_cstr(out, tag); da_append(out, '>');
-			parse_inline(&r, trimmed);
-			da_append_cstr(out, "</"); da_append_cstr(out, tag); da_append_cstr(out, ">\n");
+	MiteObject* obj = find_object(objects, name);
+	if (obj) obj->used = true;
+	if (obj && obj->hash == hash && file_exists(o_path)) return hash;
 
-		} else if (starts_with(trimmed, "- [ ] ")) {
-			end_paragraph();
-			end_list();
-			da_append_cstr(out, "<ul><li><input type=\"checkbox\" disabled>");
-			parse_inline(&r, trimmed + 6);
-			da_append_cstr(out, "</li></ul>\n");
+	write_to_file(c_path, code);
+	da_append(compiled, ((MiteObject){ .name = strdup(name), .hash = hash }));
 
-		} else if (starts_with(trimmed, "- ") || starts_with(trimmed, "* ")) {
-			end_paragraph();
-			start_list();
-			da_append_cstr(out, "<li>");
-			parse_inline(&r, trimmed + 2);
-			da_append_cstr(out, "</li>\n");
+	char command[MAX_PATH_LEN * 3];
+	if (module) snprintf(command, sizeof(command), MITE_CC MITE_MODULE_FLAGS" -o %s %s", o_path, c_path);
+	else        snprintf(command, sizeof(command), MITE_CC" -c -o %s %s", o_path, c_path);
+	da_append_cstr(commands, command);
+	da_append(commands, '\0');
+	return hash;
+}
 
-		} else if (starts_with(trimmed, "> ")) {
-			end_paragraph();
-			end_list();
-			da_append_cstr(out, "<blockquote>");
-			parse_inline(&r, trimmed + 2);
-			da_append_cstr(out, "</blockquote>\n");
+// --daemon: the sorts of the page run before the host renders in parallel
+void codegen_page_prepare(StringBuilder* out, MitePage* mp) {
+	StringBuilder sorts = {0};
+	scan_global_sorts(SB_TO_SV(&mp->rendered_code), &sorts);
+	if (sorts.count) {
+		da_append_cstr(out, "void prepare_");
+		da_append_cstr(out, mp->name);
+		da_append_cstr(out, "(void) {\n");
+		da_append_sv(out, &sorts);
+		da_append_cstr(out, "}\n");
+	}
+	free(sorts.items);
+}
 
-		} else if (starts_with(trimmed, "```")) {
-			if (trimmed == md->items) {
-				// frontmatter
-				const char* end = strstr(trimmed + 3, "```");
-				if (end) {
-					skip_after_newline(&trimmed);
-					da_append_cstr(out_fm, "<?");
-					da_append_many(out_fm, trimmed, end - trimmed);
-					da_append_cstr(out_fm, "?>\n");
-					r.cursor = end + 3;
-					continue;
-				}
-			}
+#ifdef MITE_HOT_RELOAD
+void host_stop(MiteHost* host) {
+	if (!host->running) return;
+	fclose(host->commands);
+	close(host->replies);
+	*host = (MiteHost){0};
+}
 
-			end_paragraph();
-			end_list();
+// the host is started by a child that exits right away, so the compile jobs never wait
+// for it, and it exits on its own once its stdin is closed. its replies come on fd 3
+bool host_start(MiteHost* host, size_t jobs) {
+	int commands[2], replies[2];
+	if (pipe(commands) != 0) return false;
+	if (pipe(replies) != 0) {
+		close(commands[0]);
+		close(commands[1]);
+		return false;
+	}
+	fcntl(commands[1], F_SETFD, FD_CLOEXEC);
+	fcntl(replies[0], F_SETFD, FD_CLOEXEC);
+	signal(SIGPIPE, SIG_IGN);
+
+	char line[256] = "exec "MITE_HOST_BINARY" --host 3";
+	append_site_args(line, sizeof(line), jobs);
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (fork() != 0) _exit(0);
+		dup2(commands[0], 0);
+		dup2(replies[1], 3);
+		// connections of the server must close when the server closes them
+		for (int fd = 4; fd < 1024; ++fd) close(fd);
+		execl("/bin/sh", "sh", "-c", line, NULL);
+		_exit(127);
+	}
+	close(commands[0]);
+	close(replies[1]);
+	if (pid < 0) {
+		close(commands[1]);
+		close(replies[0]);
+		return false;
+	}
+	waitpid(pid, NULL, 0);
+	host->commands = fdopen(commands[1], "w");
+	host->replies = replies[0];
+	host->running = host->commands != NULL;
+	if (!host->running) close(replies[0]);
+	return host->running;
+}
 
-			const char* code_end = strstr(trimmed + 3, "```");
-			if (!code_end) code_end = md->items + md->count;
+// sends one build to the host, see site_host, and waits until it wrote the pages
+int host_render(MiteHost* host, const char* templates_path, StringBuilder* pages) {
+	fprintf(host->commands, "templates %s\n", templates_path);
+	fwrite(pages->items, 1, pages->count, host->commands);
+	fprintf(host->commands, g_render_serial ? "render serial\n" : "render\n");
+	bool ok = fflush(host->commands) == 0;
+
+	char reply[64];
+	size_t len = 0;
+	while (ok && len + 1 < sizeof(reply)) {
+		ssize_t n = read(host->replies, reply + len, 1);
+		if (n <= 0) ok = false;
+		else if (reply[len++] == '\n') break;
+	}
+	reply[len] = '\0';
+	int result = 1;
+	if (!ok || 1 != sscanf(reply, "done %d", &result)) {
+		printf("[error] the site host stopped\n");
+		host_stop(host);
+		return 1;
+	}
+	return result;
+}
+#endif // MITE_HOT_RELOAD
 
-			skip_after_newline(&trimmed); // skip language
-			da_append_cstr(out, "<pre><code>\n");
-			da_append_escape_html(out, trimmed, code_end - trimmed);
-			da_append_cstr(out, "</code></pre>\n");
+int build_and_run_split_site(MitePages* pages, MiteTemplates* templates,
+							 const char* source_path, uint64_t source_hash, size_t jobs, MiteHost* host) {
+	if (!make_directory(MITE_BUILD_DIR)) {
+		printf("[error] could not create %s: %s\n", MITE_BUILD_DIR, strerror(errno));
+		return 1;
+	}
+	size_t phase = timing_begin("codegen");
+	bool hot = host != NULL;
 
-			r.cursor = code_end + 3;
-			continue;
+	MiteObjects objects = {0};
+	MiteObjects compiled = {0};
+	load_object_index(&objects);
 
-		} else if (starts_with(trimmed, "![")) {
-			// figure
-			end_paragraph();
-			parse_inline(&r, trimmed);
+	StringBuilder code = {0};
+	StringBuilder link_args = {0};
+	StringBuilder commands = {0};
+	StringBuilder host_pages = {0};
+	char name[MAX_PATH_LEN];
+	char path[MAX_PATH_LEN + 64];
+	char buffer[64];
 
-		} else {
-			end_list();
-			start_paragraph();
-			parse_inline(&r, trimmed);
-			da_append(out, '\n');
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		snprintf(name, sizeof(name), "page_%s", mp->name);
+		MiteObject* obj = find_object(&objects, name);
+		if (obj) obj->used = true;
+		if (!mp->dirty) continue;
+
+		code.count = 0;
+		split_include_header(&code, source_path, source_hash);
+		MiteHashSet emitted = {0};
+		codegen_html_chunks(&code, &mp->html, &emitted);
+		free(emitted.items);
+		codegen_page(&code, mp, templates);
+		if (hot) codegen_page_prepare(&code, mp);
+		uint64_t hash = split_add_unit(&objects, name, &code, hot, hot ? NULL : &link_args, &commands, &compiled);
+		if (!hot) continue;
+
+		// the same layout as codegen_main binds
+		StringView layout = page_layout_name(mp);
+		MiteTemplate* mt = find_mite_template(templates, layout);
+		split_unit_path(path, sizeof(path), name, hash, true);
+		snprintf(buffer, sizeof(buffer), "page %d %d ", (int)i, (int)page_size_hint(mp, mt));
+		da_append_cstr(&host_pages, buffer);
+		da_append_cstr(&host_pages, mt ? mt->name : sv_eq_cstr(layout, "-") ? "-" : "*");
+		da_append(&host_pages, ' ');
+		da_append_cstr(&host_pages, mp->name);
+		da_append(&host_pages, ' ');
+		da_append_cstr(&host_pages, path);
+		da_append(&host_pages, '\n');
+	}
+
+	// the front matter of a group only recompiles with the group
+	size_t groups = (pages->count + MITE_SPLIT_GROUP_PAGES - 1) / MITE_SPLIT_GROUP_PAGES;
+	for (size_t g = 0; g < groups; ++g) {
+		size_t first = g * MITE_SPLIT_GROUP_PAGES;
+		size_t last = first + MITE_SPLIT_GROUP_PAGES < pages->count ? first + MITE_SPLIT_GROUP_PAGES : pages->count;
+		code.count = 0;
+		split_include_header(&code, source_path, source_hash);
+		da_append_cstr(&code, "extern SitePage* site_pages[];\n");
+		snprintf(buffer, sizeof(buffer), "void construct_global_state_%d(void) {\n", (int)g);
+		da_append_cstr(&code, buffer);
+		codegen_construct_pages(&code, pages, first, last);
+		da_append_cstr(&code, "}\n");
+		snprintf(name, sizeof(name), "global_%d", (int)g);
+		split_add_unit(&objects, name, &code, false, &link_args, &commands, &compiled);
+	}
+
+	code.count = 0;
+	split_include_header(&code, source_path, source_hash);
+	da_append_cstr(&code,
+		"#ifndef SITE_NO_ARENA\n"
+		"SITE_THREAD_LOCAL SiteArena site_arena;\n"
+		"SITE_THREAD_LOCAL SiteArena site_scratch_arena;\n"
+		"SITE_THREAD_LOCAL bool site_rendering;\n"
+		"#endif\n"
+		"#ifndef SITE_NO_STREAM\n"
+		"SITE_THREAD_LOCAL SiteStream* site_stream;\n"
+		"#endif\n"
+	);
+	codegen_global_variables(&code, pages);
+	for (size_t g = 0; g < groups; ++g) {
+		snprintf(buffer, sizeof(buffer), "void construct_global_state_%d(void);\n", (int)g);
+		da_append_cstr(&code, buffer);
+	}
+	da_append_cstr(&code, "void construct_global_state(void) {\n");
+	for (size_t g = 0; g < groups; ++g) {
+		snprintf(buffer, sizeof(buffer), "	construct_global_state_%d();\n", (int)g);
+		da_append_cstr(&code, buffer);
+	}
+	da_append_cstr(&code, "}\n");
+	split_add_unit(&objects, "global", &code, false, &link_args, &commands, &compiled);
+
+	char templates_path[MAX_PATH_LEN] = {0};
+	if (hot) {
+		// the host loads the templates, and the pages bound to them, as modules
+		code.count = 0;
+		split_include_header(&code, source_path, source_hash);
+		MiteHashSet emitted = {0};
+		for (size_t i = 0; i < templates->count; ++i) {
+			codegen_html_chunks(&code, &templates->items[i].html, &emitted);
+		}
+		free(emitted.items);
+		codegen_templates(&code, templates);
+		da_append_cstr(&code, "void prepare_templates(void) {\n");
+		for (size_t i = 0; i < templates->count; ++i) {
+			scan_global_sorts(SB_TO_SV(&templates->items[i].rendered_code), &code);
+		}
+		da_append_cstr(&code, "}\n");
+		uint64_t hash = split_add_unit(&objects, "templates", &code, true, NULL, &commands, &compiled);
+		split_unit_path(templates_path, sizeof(templates_path), "templates", hash, true);
+
+		code.count = 0;
+		da_append_cstr(&code, "#define SITE_HOST\n");
+		split_include_header(&code, source_path, source_hash);
+		da_append_cstr(&code,
+			"int main(int argc, char** argv) {\n"
+			"	construct_global_state();\n"
+			"	site_parse_dates(&global.pages);\n"
+			"	site_index_tags(&global.tags, &global.pages);\n"
+			"	return site_host(argc, argv);\n"
+			"}\n"
+		);
+		split_add_unit(&objects, "host", &code, false, &link_args, &commands, &compiled);
+	} else {
+		code.count = 0;
+		split_include_header(&code, source_path, source_hash);
+		da_append_cstr(&code,
+			"extern SitePage* site_pages[];\n"
+			"void construct_global_state(void);\n"
+		);
+		for (size_t i = 0; i < pages->count; ++i) {
+			if (!pages->items[i].dirty) continue;
+			codegen_page_declaration(&code, &pages->items[i]);
+			da_append_cstr(&code, ";\n");
+		}
+		MiteHashSet emitted = {0};
+		for (size_t i = 0; i < templates->count; ++i) {
+			codegen_html_chunks(&code, &templates->items[i].html, &emitted);
 		}
+		free(emitted.items);
+		codegen_templates(&code, templates);
+		codegen_main(&code, pages, templates);
+		split_add_unit(&objects, "site", &code, false, &link_args, &commands, &compiled);
+	}
 
-		if (r.cursor > line_end) continue;
-		r.cursor = (*line_end == '\n') ? line_end + 1 : line_end;
+	const char** lines = calloc(compiled.count + 1, sizeof(char*));
+	const char* line = commands.items;
+	for (size_t i = 0; i < compiled.count; ++i) {
+		lines[i] = line;
+		line += strlen(line) + 1;
 	}
 
-	end_paragraph();
-	end_list();
+	size_t units = 3 + groups;
+	for (size_t i = 0; i < pages->count; ++i) if (pages->items[i].dirty) units++;
+	if (!hot) units--;
+	size_t cached = units - compiled.count;
+	timing_end(phase);
+	printf("[compiling] %d units, %d cached\n", (int)compiled.count, (int)cached);
+	phase = timing_begin("compile");
+	MiteSpan* spans = g_timings.enabled ? calloc(compiled.count + 1, sizeof(MiteSpan)) : NULL;
+	bool ok = execute_lines_parallel(lines, compiled.count, jobs, spans);
+	free(lines);
+	for (size_t i = 0; spans && i < compiled.count; ++i) {
+		if (!spans[i].wall) continue;
+		da_append(&g_timings.units, ((MiteUnitTiming){ .name = strdup(compiled.items[i].name), .span = spans[i] }));
+	}
+	free(spans);
+
+	// a new global state needs a new host
+	bool relink = hot;
+	if (hot) {
+		relink = !file_exists(MITE_HOST_BINARY);
+		for (size_t i = 0; i < compiled.count; ++i) {
+			if (0 == strncmp(compiled.items[i].name, "global", 6) || 0 == strcmp(compiled.items[i].name, "host")) relink = true;
+		}
+	}
 
-	if (out->count)    da_append(out, '\0');
-	if (out_fm->count) da_append(out_fm, '\0');
+	// forget the objects of removed pages, remember the new ones
+	size_t kept = 0;
+	for (size_t i = 0; i < objects.count; ++i) {
+		MiteObject* obj = &objects.items[i];
+		MiteObject* recompiled = find_object(&compiled, obj->name);
+		if (obj->used && !recompiled) {
+			objects.items[kept++] = *obj;
+			continue;
+		}
+		if (!obj->used) {
+			snprintf(name, sizeof(name), MITE_BUILD_DIR"/%s.c", obj->name); remove(name);
+			snprintf(name, sizeof(name), MITE_BUILD_DIR"/%s.o", obj->name); remove(name);
+		}
+		if (!recompiled || recompiled->hash != obj->hash) {
+			split_unit_path(name, sizeof(name), obj->name, obj->hash, true);
+			remove(name);
+		}
+		free(obj->name);
+	}
+	objects.count = kept;
+	if (ok) {
+		for (size_t i = 0; i < compiled.count; ++i) da_append(&objects, compiled.items[i]);
+	} else {
+		for (size_t i = 0; i < compiled.count; ++i) free(compiled.items[i].name);
+	}
+	save_object_index(&objects);
+
+	int result = ok ? 0 : 1;
+#ifdef MITE_HOT_RELOAD
+	if (ok && hot) {
+		if (relink) {
+			host_stop(host);
+			write_to_file(MITE_HOST_LINK_ARGS_PATH, &link_args);
+			result = execute_line(MITE_CC" -rdynamic -o "MITE_HOST_BINARY" @"MITE_HOST_LINK_ARGS_PATH MITE_SITE_LIBS" -ldl");
+		}
+		timing_end(phase);
+		if (result == 0) {
+			phase = timing_begin("run");
+			if (!host->running && !host_start(host, jobs)) {
+				printf("[error] could not start the site host\n");
+				result = 1;
+			} else {
+				result = host_render(host, templates_path, &host_pages);
+			}
+			timing_end(phase);
+		}
+	} else
+#endif
+	{
+		if (ok) {
+			write_to_file(MITE_LINK_ARGS_PATH, &link_args);
+			result = execute_line(MITE_CC" -o "SITE_BINARY" @"MITE_LINK_ARGS_PATH MITE_SITE_LIBS);
+		}
+		timing_end(phase);
+		if (result == 0) {
+			char line[256] = SITE_RUN;
+			append_site_args(line, sizeof(line), jobs);
+			phase = timing_begin("run");
+			result = execute_line(line);
+			timing_end(phase);
+		}
+	}
 
-#undef start_paragraph
-#undef   end_paragraph
-#undef start_list
-#undef   end_list
+	for (size_t i = 0; i < objects.count; ++i) free(objects.items[i].name);
+	free(objects.items);
+	free(compiled.items);
+	free(code.items);
+	free(link_args.items);
+	free(commands.items);
+	free(host_pages.items);
+	return result;
 }
 
 
-// ------------------- /md2html/ ------------------------
+// modification time in nanoseconds and size, false if the file does not exist
+bool get_file_info(const char* path_cstr, uint64_t* mtime, uint64_t* size) {
+#ifndef _WIN32
+	struct stat st;
+	if (stat(path_cstr, &st) != 0) return false;
+#ifdef __APPLE__
+	*mtime = (uint64_t)st.st_mtimespec.tv_sec * 1000000000ULL + (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+	*mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+	*size = (uint64_t)st.st_size;
+	return true;
+#else
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!GetFileAttributesExA(path_cstr, GetFileExInfoStandard, &attr)) return false;
 
+	FILETIME ft = attr.ftLastWriteTime;
+	ULARGE_INTEGER ull;
+	ull.LowPart  = ft.dwLowDateTime;
+	ull.HighPart = ft.dwHighDateTime;
 
-typedef struct {
-	char* name;
-	char* path;
-	StringBuilder rendered_code;
-	bool is_include;
-} MiteTemplate;
+	*mtime = (ull.QuadPart - 116444736000000000ULL) * 100ULL;
+	*size = ((uint64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+	return true;
+#endif
+}
 
-typedef struct {
-	char* name;
-	char* md_path;
-	char* final_html_path;
 
-	StringBuilder rendered_code;
-	StringBuilder front_matter;
-} MitePage;
 
-typedef struct {
-	MitePage* items;
-	size_t count;
-	size_t capacity;
-} MitePages;
 
-typedef struct {
-	MiteTemplate* items;
-	size_t count;
-	size_t capacity;
-} MiteTemplates;
+// ------------------- build cache ----------------------
+// the manifest of the last successful build, lets --incremental rerender only
+// the pages affected by a change:
+//   mite-cache <version>
+//   source <mite.c hash>
+//   template <hash> <name> <includes...>
+//   page <mtime> <size> <md hash> <front matter hash> <front matter length> <md path>
+//   deps <layout> <includes...>
+//   <front matter code>
+//   dir <mtime> <first page> <page count> <subtree> <path>
+//   asset <mtime> <size> <hash> <path>
+#define MITE_CACHE_PATH "./.mite-cache"
+#define MITE_CACHE_VERSION 3
 
+typedef struct {
+	StringView md_path;
+	uint64_t mtime;
+	uint64_t size;
+	uint64_t md_hash;
+	uint64_t fm_hash;
+	StringView deps;
+	StringView front_matter;
+} MiteCachePage;
 
-static inline StringView sv_trim(StringView input) {
-	StringView sv = input;
+typedef struct {
+	StringView name;
+	uint64_t hash;
+} MiteCacheTemplate;
 
-	int l = 0;
-	while (l < sv.count && (sv.items[l] == ' ' || sv.items[l] == '\t' || sv.items[l] == '\n' || sv.items[l] == '\r')) l++;
+typedef struct {
+	StringView path;
+	uint64_t mtime;
+	size_t first_page;
+	size_t page_count;
+	size_t subtree;
+} MiteCacheDir;
 
-	sv.items += l;
-	sv.count -= l;
+typedef struct {
+	StringView path;
+	uint64_t mtime;
+	uint64_t size;
+	uint64_t hash;
+} MiteCacheAsset;
 
-	int r = sv.count - 1;
-	while (r >= 0 && (sv.items[r] == ' ' || sv.items[r] == '\t' || sv.items[r] == '\n' || sv.items[r] == '\r')) r--;
+typedef struct {
+	StringBuilder data;
+	uint64_t source_hash;
+	struct {
+		MiteCachePage* items;
+		size_t count;
+		size_t capacity;
+	} pages;
+	struct {
+		MiteCacheTemplate* items;
+		size_t count;
+		size_t capacity;
+	} templates;
+	struct {
+		MiteCacheDir* items;
+		size_t count;
+		size_t capacity;
+	} dirs;
+	struct {
+		MiteCacheAsset* items;
+		size_t count;
+		size_t capacity;
+	} assets;
+	bool loaded;
+} MiteCache;
+
+static inline StringView sv_chop_line(StringView* input) {
+	return chop_until(input, "\n", 1);
+}
 
-	sv.count = r + 1;
+bool load_cache(MiteCache* cache) {
+	if (!file_exists(MITE_CACHE_PATH)) return false;
+	if (!read_entire_file(MITE_CACHE_PATH, &cache->data)) return false;
+	da_append(&cache->data, '\0');
+
+	StringView input = SB_TO_SV(&cache->data);
+	input.count--;
+	StringView line = sv_chop_line(&input);
+	int version = 0;
+	if (line.count < 12 || 1 != sscanf(line.items, "mite-cache %d", &version)) return false;
+	if (version != MITE_CACHE_VERSION) return false;
+
+	while (input.count) {
+		line = sv_chop_line(&input);
+		// sscanf measures the whole string first, it only gets to see this line
+		char* line_end = line.items + line.count;
+		char saved = *line_end;
+		*line_end = '\0';
+		int n = 0;
+		unsigned long long mtime, size, md_hash, fm_hash, fm_len, hash;
+
+		if (line.count > 7 && 0 == strncmp(line.items, "source ", 7)) {
+			if (1 != sscanf(line.items, "source %llx", &hash)) return false;
+			cache->source_hash = hash;
+
+		} else if (line.count > 9 && 0 == strncmp(line.items, "template ", 9)) {
+			if (1 != sscanf(line.items, "template %llx %n", &hash, &n) || n == 0) return false;
+			StringView rest = { .items = line.items + n, .count = line.count - n };
+			MiteCacheTemplate ct = { .name = chop_until(&rest, " ", 1), .hash = hash };
+			da_append(&cache->templates, ct);
+
+		} else if (line.count > 5 && 0 == strncmp(line.items, "page ", 5)) {
+			if (5 != sscanf(line.items, "page %llu %llu %llx %llx %llu %n",
+						&mtime, &size, &md_hash, &fm_hash, &fm_len, &n) || n == 0) return false;
+			MiteCachePage cp = {
+				.md_path = { .items = line.items + n, .count = line.count - n },
+				.mtime = mtime, .size = size, .md_hash = md_hash, .fm_hash = fm_hash,
+			};
+			StringView deps = sv_chop_line(&input);
+			if (deps.count < 5 || 0 != strncmp(deps.items, "deps ", 5)) return false;
+			cp.deps.items = deps.items + 5;
+			cp.deps.count = deps.count - 5;
+			if (input.count < fm_len + 1) return false;
+			cp.front_matter.items = input.items;
+			cp.front_matter.count = fm_len;
+			input.items += fm_len + 1;
+			input.count -= fm_len + 1;
+			da_append(&cache->pages, cp);
+
+		} else if (line.count > 4 && 0 == strncmp(line.items, "dir ", 4)) {
+			unsigned long long first, count, subtree;
+			if (4 != sscanf(line.items, "dir %llu %llu %llu %llu %n", &mtime, &first, &count, &subtree, &n) || n == 0) return false;
+			MiteCacheDir cd = {
+				.path = { .items = line.items + n, .count = line.count - n },
+				.mtime = mtime, .first_page = first, .page_count = count, .subtree = subtree,
+			};
+			da_append(&cache->dirs, cd);
+
+		} else if (line.count > 6 && 0 == strncmp(line.items, "asset ", 6)) {
+			if (3 != sscanf(line.items, "asset %llu %llu %llx %n", &mtime, &size, &hash, &n) || n == 0) return false;
+			MiteCacheAsset ca = {
+				.path = { .items = line.items + n, .count = line.count - n },
+				.mtime = mtime, .size = size, .hash = hash,
+			};
+			da_append(&cache->assets, ca);
+
+		} else if (line.count) {
+			return false;
+		}
+		*line_end = saved;
+	}
 
-	return sv;
+	cache->loaded = true;
+	return true;
 }
-static inline StringView sv_trim_empty_lines(StringView input) {
-	StringView sv = input;
 
-	int empty = 0;
-	while (empty < sv.count && (sv.items[empty] == ' ' || sv.items[empty] == '\t')) empty++;
+void save_cache(MitePages* pages, MiteTemplates* templates, MiteSourceDirs* dirs, uint64_t source_hash) {
+	StringBuilder out = {0};
+	char buffer[256];
 
-	if (empty+1 < sv.count && sv.items[empty+1] == '\n') {
-		sv.items += empty;
-		sv.count -= empty;
-	}
+	snprintf(buffer, sizeof(buffer), "mite-cache %d\nsource %016llx\n", MITE_CACHE_VERSION, (unsigned long long)source_hash);
+	da_append_cstr(&out, buffer);
 
-	int r = sv.count - 1;
-	while (r >= 0 && (sv.items[r] == ' ' || sv.items[r] == '\t' || sv.items[r] == '\n' || sv.items[r] == '\r')) r--;
-	sv.count = r + 1;
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+		snprintf(buffer, sizeof(buffer), "template %016llx ", (unsigned long long)mt->hash);
+		da_append_cstr(&out, buffer);
+		da_append_cstr(&out, mt->name);
+		if (mt->includes.count) da_append(&out, ' ');
+		da_append_sv(&out, &mt->includes);
+		da_append(&out, '\n');
+	}
 
-	return sv;
-}
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		snprintf(buffer, sizeof(buffer), "page %llu %llu %016llx %016llx %llu ",
+			(unsigned long long)mp->md_mtime, (unsigned long long)mp->md_size,
+			(unsigned long long)mp->md_hash, (unsigned long long)mp->fm_hash,
+			(unsigned long long)mp->front_matter.count);
+		da_append_cstr(&out, buffer);
+		da_append_cstr(&out, mp->md_path);
+		da_append_cstr(&out, "\ndeps ");
+		da_append_sv(&out, &mp->deps);
+		da_append(&out, '\n');
+		da_append_sv(&out, &mp->front_matter);
+		da_append(&out, '\n');
+	}
 
-static inline StringView chop_until(StringView* input, const char* delim, const size_t delim_count) {
-    StringView line = {0};
-    if (!input || !delim)  return line;
-    if (input->count == 0) return line;
-    if (delim_count == 0)  return line;
-    if (input->count < delim_count) return line;
+	for (size_t i = 0; i < dirs->count; ++i) {
+		MiteSourceDir* d = &dirs->items[i];
+		snprintf(buffer, sizeof(buffer), "dir %llu %llu %llu %llu ",
+			(unsigned long long)d->mtime, (unsigned long long)d->first_page,
+			(unsigned long long)d->page_count, (unsigned long long)d->subtree);
+		da_append_cstr(&out, buffer);
+		da_append_cstr(&out, d->path);
+		da_append(&out, '\n');
+	}
 
-	size_t i = 0;
-	while (i < input->count) {
-		size_t equal = 0;
-		for (size_t d = 0; d < delim_count; ++d) {
-			if (i+d >= input->count) break;
-			if (input->items[i+d] == delim[d]) equal++;
-		}
-		if (equal == delim_count) break;
-		++i;
+	for (size_t i = 0; i < g_assets.count; ++i) {
+		MiteAsset* a = &g_assets.items[i];
+		snprintf(buffer, sizeof(buffer), "asset %llu %llu %016llx ",
+			(unsigned long long)a->mtime, (unsigned long long)a->size, (unsigned long long)a->hash);
+		da_append_cstr(&out, buffer);
+		da_append_cstr(&out, a->path);
+		da_append(&out, '\n');
 	}
 
-	line.items = input->items;
-	line.count = i;
+	write_to_file(MITE_CACHE_PATH, &out);
+	free(out.items);
+}
 
-	if (i == input->count) {
-		input->items += input->count;
-		input->count = 0;
-	} else {
-		input->items += i + delim_count;
-		input->count -= i + delim_count;
-	}
+void free_cache(MiteCache* cache) {
+	free(cache->data.items);
+	free(cache->pages.items);
+	free(cache->templates.items);
+	free(cache->dirs.items);
+	free(cache->assets.items);
+	*cache = (MiteCache){0};
+}
 
-	return line;
+// pages are usually found in the same order as the last build
+MiteCachePage* cache_find_page(MiteCache* cache, const char* md_path, size_t hint) {
+	if (hint < cache->pages.count && sv_eq_cstr(cache->pages.items[hint].md_path, md_path)) {
+		return &cache->pages.items[hint];
+	}
+	for (size_t i = 0; i < cache->pages.count; ++i) {
+		if (sv_eq_cstr(cache->pages.items[i].md_path, md_path)) return &cache->pages.items[i];
+	}
+	return NULL;
 }
 
+// ------------------- assets ---------------------------
+// --fingerprint copies every asset named by a literal ASSET("path") of a template or page
+// next to it, with the hash of its contents in the name. the copies never change, so they
+// can be served with `Cache-Control: immutable`. hashes are kept in the build cache and
+// only recomputed when the stat of an asset changes
+static void assets_index(MiteAssets* assets) {
+	free(assets->table);
+	assets->table_size = 64;
+	while (assets->table_size < assets->count * 2) assets->table_size *= 2;
+	assets->table = calloc(assets->table_size, sizeof(size_t));
+
+	size_t mask = assets->table_size - 1;
+	for (size_t i = 0; i < assets->count; ++i) {
+		size_t slot = hash_bytes(assets->items[i].path, strlen(assets->items[i].path)) & mask;
+		while (assets->table[slot]) slot = (slot + 1) & mask;
+		assets->table[slot] = i + 1;
+	}
+}
 
-void sv_to_c_code(StringView sv, StringBuilder* out) {
-	da_append_many(out, sv.items, sv.count);
-	da_append(out, '\n');
+MiteAsset* find_asset(MiteAssets* assets, const char* path, size_t len) {
+	if (!assets->table) return NULL;
+	size_t mask = assets->table_size - 1;
+	for (size_t slot = hash_bytes(path, len) & mask; assets->table[slot]; slot = (slot + 1) & mask) {
+		MiteAsset* a = &assets->items[assets->table[slot] - 1];
+		if (strlen(a->path) == len && 0 == memcmp(a->path, path, len)) return a;
+	}
+	return NULL;
 }
 
-typedef struct {
-	StringBuilder string;
-	size_t count;
-} ByteArray;
+MiteAsset* add_asset(MiteAssets* assets, const char* path, size_t len) {
+	MiteAsset* found = find_asset(assets, path, len);
+	if (found) return found;
 
-void byte_array_to_c_code(ByteArray* ba, StringBuilder* out) {
-	if (ba->count == 0) return;
-	if (ba->count == 1 && ba->string.count == 4) {
-		if (0 == strncmp(ba->string.items, "\\x0a", 4)) return;
+	MiteAsset a = { .path = malloc(len + 1) };
+	memcpy(a.path, path, len);
+	a.path[len] = '\0';
+	da_append(assets, a);
+	if (assets->table_size < assets->count * 2) {
+		assets_index(assets);
+	} else {
+		size_t mask = assets->table_size - 1;
+		size_t slot = hash_bytes(path, len) & mask;
+		while (assets->table[slot]) slot = (slot + 1) & mask;
+		assets->table[slot] = assets->count;
 	}
-	da_append_cstr(out, "OUT_HTML(\"");
-	static char buffer[16] = {0};
-	da_append_many(out, ba->string.items, ba->string.count);
-	sprintf(buffer, "\", %d)\n", (int)ba->count);
-	da_append_cstr(out, buffer);
+	return &assets->items[assets->count - 1];
 }
 
-char to_hex_char(uint8_t n) {
-	return (n < 10) ? ('0' + n) : ('a' + n - 10);
+// "/css/style.css" becomes "/css/style.1a2b3c4d.css"
+static void asset_set_url(MiteAsset* a) {
+	free(a->url);
+	size_t len = strlen(a->path);
+	a->url = malloc(len + 16);
+	const char* name = strrchr(a->path, '/');
+	const char* ext = strrchr(name ? name : a->path, '.');
+	if (!a->hash) {
+		snprintf(a->url, len + 16, "/%s", a->path);
+	} else if (ext && ext != (name ? name + 1 : a->path)) {
+		snprintf(a->url, len + 16, "/%.*s.%08x%s", (int)(ext - a->path), a->path, (unsigned)(a->hash & 0xffffffff), ext);
+	} else {
+		snprintf(a->url, len + 16, "/%s.%08x", a->path, (unsigned)(a->hash & 0xffffffff));
+	}
 }
 
-void sv_to_byte_array(StringView sv, ByteArray* out) {
-	char buffer[4] = { '\\', 'x', 0, 0 };
-	for (uint64_t i = 0; i < sv.count; ++i) {
-		uint8_t c = (uint8_t)sv.items[i];
-		if (c == '\0') break;
-		buffer[2] = to_hex_char(c >> 4);
-		buffer[3] = to_hex_char(c & 0xF);
-		da_append_many(&out->string, buffer, 4);
-		out->count++;
+// rehashes the asset when its stat changed and writes its copy when it is missing,
+// the copy of an older version is removed
+static void update_asset(MiteAssets* assets, MiteAsset* a) {
+	char path[MAX_PATH_LEN];
+	snprintf(path, sizeof(path), "./%s", a->path);
+	uint64_t mtime = 0, size = 0;
+	if (!get_file_info(path, &mtime, &size)) {
+		if (a->hash || !a->url) printf("[warning] asset not found '%s'\n", a->path);
+		a->mtime = a->size = a->hash = 0;
+		asset_set_url(a);
+		return;
 	}
-}
 
+	StringBuilder data = {0};
+	bool stat_changed = !a->hash || a->mtime != mtime || a->size != size;
+	if (stat_changed) {
+		if (!read_entire_file(path, &data)) return;
+		uint64_t hash = hash_bytes(data.items, data.count);
+		if (a->hash && a->hash != hash) {
+			if (!a->url) asset_set_url(a);
+			char old[MAX_PATH_LEN];
+			snprintf(old, sizeof(old), ".%s", a->url);
+			remove(old);
+		}
+		if (!a->url || a->hash != hash) {
+			a->hash = hash;
+			asset_set_url(a);
+		}
+		a->mtime = mtime;
+		a->size = size;
+		assets->hashed++;
+	} else if (!a->url) {
+		asset_set_url(a);
+	}
 
-// NOTE: source must be null terminated
-void render_html_to_c(StringView source, StringBuilder* out) {
-	bool html_mode = true;
-	ByteArray ba = {0};
-	while (source.count && source.items[0]) {
-		if (html_mode) {
-			StringView token = sv_trim_empty_lines(chop_until(&source, "<?", 2));
-			sv_to_byte_array(token, &ba);
-			byte_array_to_c_code(&ba, out);
-			ba.count = 0;
-			ba.string.count = 0;
-		} else {
-			StringView token = sv_trim(chop_until(&source, "?>", 2));
-			sv_to_c_code(token, out);
+	char copy[MAX_PATH_LEN];
+	snprintf(copy, sizeof(copy), ".%s", a->url);
+	if (!file_exists(copy)) {
+		if (data.count || read_entire_file(path, &data)) {
+			if (write_to_file(copy, &data)) assets->copied++;
 		}
-		html_mode = !html_mode;
 	}
-	free(ba.string.items);
+	free(data.items);
 }
 
-bool render_mite_layout(MiteTemplate* mite) {
-	if (mite->rendered_code.count > 0) return true;
+static int asset_compare(const void* a, const void* b) {
+	return strcmp(((const MiteAsset*)a)->path, ((const MiteAsset*)b)->path);
+}
 
-	StringBuilder tmpl = {0};
-	if (!read_entire_file(mite->path, &tmpl)) return false;
+// xor of every path and hash, changes with any asset
+uint64_t assets_digest(MiteAssets* assets) {
+	uint64_t digest = 0;
+	for (size_t i = 0; i < assets->count; ++i) {
+		MiteAsset* a = &assets->items[i];
+		digest ^= hash_bytes(a->path, strlen(a->path)) ^ (a->hash * 0x9E3779B97F4A7C15ULL);
+	}
+	return digest;
+}
 
-	render_html_to_c(SB_TO_SV(&tmpl), &mite->rendered_code);
+// brings the assets of the last build up to date before deciding what to render,
+// the pages that link them are not rendered again to find them
+uint64_t assets_refresh(MiteAssets* assets, MiteCache* cache) {
+	assets->hashed = assets->copied = 0;
+	for (size_t i = 0; i < cache->assets.count; ++i) {
+		MiteCacheAsset* ca = &cache->assets.items[i];
+		if (find_asset(assets, ca->path.items, ca->path.count)) continue;
+		MiteAsset* a = add_asset(assets, ca->path.items, ca->path.count);
+		a->mtime = ca->mtime;
+		a->size = ca->size;
+		a->hash = ca->hash;
+	}
+	for (size_t i = 0; i < assets->count; ++i) update_asset(assets, &assets->items[i]);
+	return assets_digest(assets);
+}
 
-	free(tmpl.items);
-	return true;
+// finds the ASSET("path") literals in generated code
+static void scan_assets(StringView code, MiteAssets* assets) {
+	StringView needle = { .items = "ASSET(", .count = 6 };
+	size_t i = 0;
+	while (i < code.count) {
+		StringView rest = { .items = code.items + i, .count = code.count - i };
+		size_t at = sv_strstr(rest, needle);
+		if (at == rest.count) break;
+		i += at + needle.count;
+		if (i - needle.count > 0 && is_ident_char(code.items[i - needle.count - 1])) continue;
+
+		while (i < code.count && (code.items[i] == ' ' || code.items[i] == '\t')) i++;
+		if (i >= code.count || code.items[i] != '"') continue;
+		size_t end = i + 1;
+		while (end < code.count && code.items[end] != '"' && code.items[end] != '\n') end++;
+		if (end >= code.count || code.items[end] != '"') continue;
+
+		char path[MAX_PATH_LEN];
+		StringView root = { .items = "", .count = 0 };
+		if (md_asset_path(root, code.items + i + 1, end - i - 1, path, sizeof(path))) {
+			MiteAsset* a = add_asset(assets, path, strlen(path));
+			if (!a->used && !a->url) update_asset(assets, a);
+			a->used = true;
+		}
+		i = end + 1;
+	}
 }
 
-bool render_page(MitePage* mite_page) {
-	if (!file_exists(mite_page->md_path)) return false;
+// adds the assets of the templates and the rendered pages, a full build forgets the
+// ones nothing links anymore
+void assets_collect(MiteAssets* assets, MitePages* pages, MiteTemplates* templates) {
+	bool all = true;
+	for (size_t i = 0; i < pages->count; ++i) all &= pages->items[i].dirty;
+	for (size_t i = 0; i < assets->count; ++i) assets->items[i].used = !all;
+
+	for (size_t i = 0; i < templates->count; ++i) {
+		scan_assets(SB_TO_SV(&templates->items[i].rendered_code), assets);
+	}
+	for (size_t i = 0; i < pages->count; ++i) {
+		if (pages->items[i].dirty) scan_assets(SB_TO_SV(&pages->items[i].rendered_code), assets);
+	}
 
-	StringBuilder md = {0};
-	if (!read_entire_file(mite_page->md_path, &md)) return false;
-	da_append(&md, '\0');
+	size_t kept = 0;
+	for (size_t i = 0; i < assets->count; ++i) {
+		MiteAsset* a = &assets->items[i];
+		if (a->used) {
+			assets->items[kept++] = *a;
+		} else {
+			free(a->path);
+			free(a->url);
+		}
+	}
+	assets->count = kept;
+	qsort(assets->items, assets->count, sizeof(MiteAsset), asset_compare);
+	assets_index(assets);
 
-	StringBuilder raw_html = {0};
-	StringBuilder raw_fm = {0};
-	render_md_to_html(&md, &raw_html, &raw_fm);
+	if (assets->hashed || assets->copied) {
+		printf("[fingerprinted] %d assets, %d hashed, %d copied\n",
+			(int)assets->count, (int)assets->hashed, (int)assets->copied);
+	}
+}
 
-	if (raw_fm.count == 0) {
-		printf("[warning] page does not have any front matter! '%s'\n", mite_page->md_path+2);
+void free_assets(MiteAssets* assets) {
+	for (size_t i = 0; i < assets->count; ++i) {
+		free(assets->items[i].path);
+		free(assets->items[i].url);
 	}
+	free(assets->items);
+	free(assets->table);
+	*assets = (MiteAssets){0};
+}
 
-	render_html_to_c(SB_TO_SV(&raw_html), &mite_page->rendered_code);
-	render_html_to_c(SB_TO_SV(&raw_fm), &mite_page->front_matter);
+// ------------------- source scan ----------------------
+// walks the content tree at any depth, a directory whose mtime matches the cached scan
+// had nothing added, removed or renamed, so its listing is taken from the cache instead
+typedef struct {
+#ifndef _WIN32
+	DIR* dir;
+#else
+	HANDLE find;
+	WIN32_FIND_DATAA data;
+	bool first;
+#endif
+} ScanDir;
 
-	free(md.items);
-	free(raw_html.items);
-	free(raw_fm.items);
+enum { SCAN_OTHER, SCAN_FILE, SCAN_DIR };
+
+// name is relative to parent when there is one, path is always usable on its own
+static bool scan_dir_mtime(ScanDir* parent, const char* name, const char* path, uint64_t* mtime) {
+#ifndef _WIN32
+	struct stat st;
+	if (fstatat(parent ? dirfd(parent->dir) : AT_FDCWD, parent ? name : path, &st, 0) != 0) return false;
+	if (!S_ISDIR(st.st_mode)) return false;
+#ifdef __APPLE__
+	*mtime = (uint64_t)st.st_mtimespec.tv_sec * 1000000000ULL + (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+	*mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+	return true;
+#else
+	(void)parent; (void)name;
+	uint64_t size = 0;
+	return get_file_info(path, mtime, &size);
+#endif
+}
 
+static bool scan_dir_open(ScanDir* d, ScanDir* parent, const char* name, const char* path) {
+#ifndef _WIN32
+	int fd = openat(parent ? dirfd(parent->dir) : AT_FDCWD, parent ? name : path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) return false;
+	d->dir = fdopendir(fd);
+	if (!d->dir) { close(fd); return false; }
 	return true;
+#else
+	(void)parent; (void)name;
+	char search[MAX_PATH_LEN*2];
+	join_path(search, path, "*");
+	d->find = FindFirstFileA(search, &d->data);
+	d->first = true;
+	return d->find != INVALID_HANDLE_VALUE;
+#endif
 }
 
-void render_all(MitePages* pages, MiteTemplates* templates) {
-	for (size_t i = 0; i < templates->count; ++i) {
-		MiteTemplate* mt = &templates->items[i];
-		printf("[mite] %s\n", mt->path+2);
-		if (!render_mite_layout(mt)) {
-			printf("failed to render mite layout: %s\n", mt->name);
-			exit(1);
-		}
-	}
-	for (size_t i = 0; i < pages->count; ++i) {
-		MitePage* mp = &pages->items[i];
-		printf("[page] %s\n", mp->md_path+2);
-		if (!render_page(mp)) {
-			printf("failed to render page: %s\n", mp->name);
-			exit(1);
+static const char* scan_dir_next(ScanDir* d, int* type) {
+#ifndef _WIN32
+	struct dirent* entry = readdir(d->dir);
+	if (!entry) return NULL;
+	switch (entry->d_type) {
+	case DT_REG: *type = SCAN_FILE; break;
+	case DT_DIR: *type = SCAN_DIR;  break;
+	case DT_UNKNOWN: {
+		struct stat st;
+		*type = SCAN_OTHER;
+		if (fstatat(dirfd(d->dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+			if (S_ISREG(st.st_mode)) *type = SCAN_FILE;
+			if (S_ISDIR(st.st_mode)) *type = SCAN_DIR;
 		}
+	} break;
+	default: *type = SCAN_OTHER; break;
 	}
+	return entry->d_name;
+#else
+	if (!d->first && !FindNextFileA(d->find, &d->data)) return NULL;
+	d->first = false;
+	*type = (d->data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? SCAN_DIR : SCAN_FILE;
+	if (d->data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) *type = SCAN_OTHER;
+	return d->data.cFileName;
+#endif
 }
 
+static void scan_dir_close(ScanDir* d) {
+#ifndef _WIN32
+	closedir(d->dir);
+#else
+	FindClose(d->find);
+#endif
+}
 
-bool ends_with(const char* name, const char* ext) {
-	size_t len = strlen(name);
-	size_t ext_len = strlen(ext);
-	if (len < ext_len) return false;
-	return strcmp(name + len - ext_len, ext) == 0;
+typedef struct {
+	MitePages* pages;
+	PathArena* paths;
+	MiteSourceDirs* dirs;
+	MiteCache* cache;
+	uint32_t* table;     // cache dir index + 1 by path hash
+	size_t table_size;
+	uint64_t recent;     // mtimes after this can still change within the same timestamp tick
+	struct {
+		const char** items;
+		size_t count;
+		size_t capacity;
+	} children;
+} SourceScan;
+
+static MiteCacheDir* scan_find_cached(SourceScan* s, const char* path) {
+	if (!s->table_size) return NULL;
+	size_t len = strlen(path);
+	size_t mask = s->table_size - 1;
+	for (size_t slot = hash_bytes(path, len) & mask; s->table[slot]; slot = (slot + 1) & mask) {
+		MiteCacheDir* cd = &s->cache->dirs.items[s->table[slot] - 1];
+		if (cd->path.count == len && 0 == memcmp(cd->path.items, path, len)) return cd;
+	}
+	return NULL;
 }
 
-int is_mite_file(const char* name) {
-	return ends_with(name, ".mite");
+static void scan_index_cache(SourceScan* s) {
+	size_t count = s->cache->dirs.count;
+	if (!count) return;
+	s->table_size = 16;
+	while (s->table_size < count * 2) s->table_size *= 2;
+	s->table = calloc(s->table_size, sizeof(uint32_t));
+	size_t mask = s->table_size - 1;
+	for (size_t i = 0; i < count; ++i) {
+		StringView path = s->cache->dirs.items[i].path;
+		size_t slot = hash_bytes(path.items, path.count) & mask;
+		while (s->table[slot]) slot = (slot + 1) & mask;
+		s->table[slot] = (uint32_t)(i + 1);
+	}
 }
 
-int is_md_file(const char* name) {
-	return ends_with(name, ".md");
+static inline bool sv_is_child_path(StringView sv, const char* dir, size_t dir_len) {
+	return sv.count > dir_len + 1 && 0 == memcmp(sv.items, dir, dir_len) && sv.items[dir_len] == '/'
+		&& !memchr(sv.items + dir_len + 1, '/', sv.count - dir_len - 1);
 }
 
-void join_path(char* out, const char* a, const char* b) {
-	snprintf(out, MAX_PATH_LEN*2, "%s/%s", a, b);
+// the cached listing is only used if it still describes exactly this directory
+static bool scan_cached_listing_valid(SourceScan* s, MiteCacheDir* cd, const char* path) {
+	size_t len = strlen(path);
+	size_t index = cd - s->cache->dirs.items;
+	if (cd->first_page + cd->page_count > s->cache->pages.count) return false;
+	if (index + cd->subtree >= s->cache->dirs.count) return false;
+	for (size_t i = 0; i < cd->page_count; ++i) {
+		if (!sv_is_child_path(s->cache->pages.items[cd->first_page + i].md_path, path, len)) return false;
+	}
+	for (size_t c = index + 1; c <= index + cd->subtree; c += s->cache->dirs.items[c].subtree + 1) {
+		if (!sv_is_child_path(s->cache->dirs.items[c].path, path, len)) return false;
+	}
+	return true;
 }
 
+static void scan_content_dir(SourceScan* s, ScanDir* parent, const char* name, const char* path, bool root) {
+	uint64_t mtime = 0;
+	if (!scan_dir_mtime(parent, name, path, &mtime)) return;
 
-extern char* strdup(const char*);
-void register_mite_file(MiteTemplates* templates, const char* mite_dir, const char* mite_name, bool is_include) {
-	da_append(templates, (MiteTemplate){0});
-	MiteTemplate* mt = &templates->items[templates->count-1];
+	size_t index = s->dirs->count;
+	da_append(s->dirs, ((MiteSourceDir){ .path = path, .mtime = mtime < s->recent ? mtime : 0, .first_page = s->pages->count }));
 
-	mt->path = calloc(MAX_PATH_LEN, sizeof(mite_dir));
-	join_path(mt->path, mite_dir, mite_name);
+	MiteCacheDir* cd = scan_find_cached(s, path);
+	if (cd && cd->mtime && cd->mtime == mtime && scan_cached_listing_valid(s, cd, path)) {
+		size_t len = strlen(path);
+		for (size_t i = 0; i < cd->page_count; ++i) {
+			StringView md_path = s->cache->pages.items[cd->first_page + i].md_path;
+			register_md_file(s->pages, s->paths, path, md_path.items + len + 1, md_path.count - len - 1);
+		}
+		s->dirs->items[index].page_count = cd->page_count;
+
+		size_t first = cd - s->cache->dirs.items + 1;
+		size_t end = first + cd->subtree;
+		for (size_t c = first; c < end; c += s->cache->dirs.items[c].subtree + 1) {
+			StringView child = s->cache->dirs.items[c].path;
+			char* child_path = path_arena_alloc(s->paths, child.count + 1);
+			memcpy(child_path, child.items, child.count);
+			child_path[child.count] = '\0';
+			scan_content_dir(s, NULL, NULL, child_path, false);
+		}
+	} else {
+		ScanDir d = {0};
+		if (!scan_dir_open(&d, parent, name, path)) return;
+
+		size_t base = s->children.count;
+		int type = SCAN_OTHER;
+		const char* entry;
+		while ((entry = scan_dir_next(&d, &type)) != NULL) {
+			if (entry[0] == '.') continue;
+			if (type == SCAN_FILE) {
+				bool page = root ? (0 == strcmp(entry, "index.md") || 0 == strcmp(entry, "rss.md")) : is_md_file(entry);
+				if (page) register_md_file(s->pages, s->paths, path, entry, strlen(entry));
+			} else if (type == SCAN_DIR) {
+				if (root && (0 == strcmp(entry, "layout") || 0 == strcmp(entry, "include"))) continue;
+				da_append(&s->children, path_arena_join(s->paths, path, entry, strlen(entry)));
+			}
+		}
+		s->dirs->items[index].page_count = s->pages->count - s->dirs->items[index].first_page;
 
-	mt->name = strdup(mite_name);
-	size_t len = strlen(mt->name);
-	if (len > 5 && strcmp(mt->name + len - 5, ".mite") == 0) {
-		mt->name[len-5] = '\0';
+		size_t len = strlen(path);
+		for (size_t i = base; i < s->children.count; ++i) {
+			const char* child = s->children.items[i];
+			scan_content_dir(s, &d, child + len + 1, child, false);
+		}
+		s->children.count = base;
+		scan_dir_close(&d);
 	}
-
-	mt->is_include = is_include;
+	s->dirs->items[index].subtree = s->dirs->count - index - 1;
 }
-void register_md_file(MitePages* pages, const char* md_dir, const char* md_name) {
-	da_append(pages, (MitePage){0});
-	MitePage* mp = &pages->items[pages->count-1];
 
-	mp->md_path = calloc(MAX_PATH_LEN, sizeof(md_dir));
-	join_path(mp->md_path, md_dir, md_name);
-
-	mp->name = strdup(mp->md_path+2);
-	size_t len = strlen(mp->name);
-	if (len > 3 && strcmp(mp->name + len - 3, ".md") == 0) {
-		len -= 3;
+static void scan_template_dir(MiteTemplates* templates, PathArena* paths, const char* path, bool is_include) {
+	ScanDir d = {0};
+	if (!scan_dir_open(&d, NULL, NULL, path)) return;
+	int type = SCAN_OTHER;
+	const char* entry;
+	while ((entry = scan_dir_next(&d, &type)) != NULL) {
+		if (type == SCAN_FILE && is_mite_file(entry)) register_mite_file(templates, paths, path, entry, is_include);
 	}
-	mp->name[len] = '\0';
-	for (size_t i = 0; i < len; ++i) {
-		if (!isalnum(mp->name[i])) {
-			mp->name[i] = '_';
-		}
-	}
-
-	mp->final_html_path = calloc(MAX_PATH_LEN, sizeof(md_dir));
-	join_path(mp->final_html_path, md_dir, "index.html");
+	scan_dir_close(&d);
 }
 
+// cache may be empty, then every directory is read
+void search_files(MitePages* pages, MiteTemplates* templates, PathArena* paths, MiteSourceDirs* dirs, MiteCache* cache) {
+	scan_template_dir(templates, paths, LAYOUT_DIR, false);
+	scan_template_dir(templates, paths, INCLUDE_DIR, true);
 
-void search_files(MitePages* pages, MiteTemplates* templates) {
-#ifndef _WIN32
-	DIR* root = opendir(".");
-	if (!root) return;
+	SourceScan s = {
+		.pages = pages, .paths = paths, .dirs = dirs, .cache = cache,
+		.recent = ((uint64_t)time(NULL) - 2) * 1000000000ULL,
+	};
+	scan_index_cache(&s);
+	scan_content_dir(&s, NULL, NULL, ".", true);
+	free(s.table);
+	free(s.children.items);
+}
 
-	struct dirent* entry;
 
-	while ((entry = readdir(root)) != NULL) {
-		if (entry->d_type != DT_DIR && entry->d_type != DT_REG) continue;
-		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+bool cache_dirs_match(MiteCache* cache, MiteSourceDirs* dirs) {
+	if (cache->dirs.count != dirs->count) return false;
+	for (size_t i = 0; i < dirs->count; ++i) {
+		MiteCacheDir* cd = &cache->dirs.items[i];
+		MiteSourceDir* d = &dirs->items[i];
+		if (cd->mtime != d->mtime || cd->first_page != d->first_page || cd->page_count != d->page_count
+			|| cd->subtree != d->subtree || !sv_eq_cstr(cd->path, d->path)) return false;
+	}
+	return true;
+}
 
-		// index.md
-		if (entry->d_type == DT_REG) {
-			if (0 == strcmp(entry->d_name, "index.md") || 0 == strcmp(entry->d_name, "rss.md")) {
-				register_md_file(pages, ".", entry->d_name);
-			}
+// true if any of the templates named in deps, or anything they include, has changed
+bool deps_changed(MiteTemplates* templates, StringView deps, bool any_template_changed, size_t depth) {
+	// include cycles would recurse forever at render time anyway
+	if (depth > 32) return true;
+	while (deps.count) {
+		StringView name = chop_until(&deps, " ", 1);
+		if (name.count == 0 && deps.count) continue;
+		if (name.count == 0) break;
+		if (sv_eq_cstr(name, "-")) continue;
+		if (sv_eq_cstr(name, "*")) {
+			if (any_template_changed) return true;
 			continue;
 		}
+		MiteTemplate* mt = find_mite_template(templates, name);
+		if (!mt || mt->changed) return true;
+		if (deps_changed(templates, SB_TO_SV(&mt->includes), any_template_changed, depth + 1)) return true;
+	}
+	return false;
+}
 
-		if (entry->d_type != DT_DIR) continue;
+static inline const char* page_output_path(MitePage* mp) {
+	return mp->output.count ? mp->output.items : mp->final_html_path;
+}
 
-		int dir_type = 1;
-		if (strcmp(entry->d_name, "layout") == 0)  dir_type = 2;
-		if (strcmp(entry->d_name, "include") == 0) dir_type = 3;
+// marks the pages that need to be rendered, returns their count
+// expects the templates to be rendered, renders the pages that changed since the cached build
+size_t check_need_to_render(MitePages* pages, MiteTemplates* templates, MiteCache* cache, uint64_t source_hash, size_t jobs) {
+	bool all = !cache->loaded || cache->source_hash != source_hash;
+	if (cache->pages.count != pages->count || cache->templates.count != templates->count) all = true;
 
-		char subdir_path[MAX_PATH_LEN];
-		join_path(subdir_path, ".", entry->d_name);
+	bool any_template_changed = false;
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+		mt->changed = true;
+		for (size_t j = 0; j < cache->templates.count; ++j) {
+			if (sv_eq_cstr(cache->templates.items[j].name, mt->name)) {
+				mt->changed = cache->templates.items[j].hash != mt->hash;
+				break;
+			}
+		}
+		if (mt->changed) any_template_changed = true;
+	}
 
-		DIR* subdir = opendir(subdir_path);
-		if (!subdir) continue;
+	// restore unchanged pages from the cache, render the rest to find out what changed
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		MiteCachePage* cp = cache_find_page(cache, mp->md_path, i);
+		mp->md_mtime = mp->md_size = 0;
+		if (mp->unchanged && cp) {
+			mp->md_mtime = cp->mtime;
+			mp->md_size = cp->size;
+		} else {
+			get_file_info(mp->md_path, &mp->md_mtime, &mp->md_size);
+		}
 
-		struct dirent* subentry;
-		while ((subentry = readdir(subdir)) != NULL) {
-			if (subentry->d_type != DT_REG && subentry->d_type != DT_DIR) continue;
-			if (strcmp(subentry->d_name, ".") == 0 || strcmp(subentry->d_name, "..") == 0) continue;
+		if (!cp) all = true;
+		mp->changed = true;
+		mp->dirty = true;
+		if (all || !cp || cp->mtime != mp->md_mtime || cp->size != mp->md_size) continue;
+
+		mp->front_matter.count = 0;
+		mp->deps.count = 0;
+		da_append_sv(&mp->front_matter, &cp->front_matter);
+		da_append_sv(&mp->deps, &cp->deps);
+		mp->md_hash = cp->md_hash;
+		mp->fm_hash = cp->fm_hash;
+		scan_page_output(mp);
+		mp->changed = false;
+		mp->dirty = false;
+	}
 
-			char path[MAX_PATH_LEN];
-			join_path(path, subdir_path, subentry->d_name);
+	if (!all) render_pages(pages, jobs);
 
-			if (subentry->d_type == DT_REG) {
-				if (dir_type == 1 && is_md_file(subentry->d_name)) register_md_file(pages, subdir_path, subentry->d_name);
-				if (dir_type > 1 && is_mite_file(subentry->d_name)) register_mite_file(templates, subdir_path, subentry->d_name, dir_type == 3);
-			}
+	for (size_t i = 0; i < pages->count && !all; ++i) {
+		MitePage* mp = &pages->items[i];
+		if (!mp->changed) continue;
+		MiteCachePage* cp = cache_find_page(cache, mp->md_path, i);
+		if (!cp || cp->fm_hash != mp->fm_hash) all = true; // front matter feeds the global state
+		else mp->changed = cp->md_hash != mp->md_hash;
+	}
 
-			// content
-			if (dir_type == 1 && subentry->d_type == DT_DIR) {
-				DIR* subsub = opendir(path);
-				if (!subsub) continue;
-				struct dirent* f;
-				while ((f = readdir(subsub)) != NULL) {
-					if (f->d_type != DT_REG) continue;
-					if (is_md_file(f->d_name)) {
-						register_md_file(pages, path, f->d_name);
-					}
-				}
-				closedir(subsub);
-			}
-		}
-		closedir(subdir);
+	size_t dirty = 0;
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		mp->dirty = all || mp->changed
+			|| deps_changed(templates, SB_TO_SV(&mp->deps), any_template_changed, 0)
+			|| !file_exists(page_output_path(mp));
+		if (mp->dirty) dirty++;
 	}
-	closedir(root);
-#else
-	WIN32_FIND_DATAA find_data;
-	HANDLE h_find = FindFirstFileA(".\\*", &find_data);
-	if (h_find == INVALID_HANDLE_VALUE) return;
+	return dirty;
+}
 
-	do {
-		const char* name = find_data.cFileName;
-		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
 
-		// index.md
-		if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && (0 == strcmp(name, "index.md"))) {
-			register_md_file(pages, ".", "index.md");
-			continue;
-		}
+// ------------------- watcher --------------------------
+// waits for changes with inotify on linux, kqueue on macos and the bsds and
+// ReadDirectoryChangesW on windows, other systems rescan every second
+#define MITE_WATCH_DEBOUNCE_MS 100
 
-		if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) continue;
+typedef struct {
+	int id;      // inotify watch descriptor or kqueue file descriptor
+	char* path;
+	bool is_dir;
+} WatchEntry;
 
-		int dir_type = 1;
-		if (strcmp(name, "layout") == 0)  dir_type = 2;
-		if (strcmp(name, "include") == 0) dir_type = 3;
+typedef struct {
+	StringBuilder changed; // NUL separated paths of the changed sources
+	size_t changed_count;
+	bool rescan;           // directories were added or removed, or events were lost
+	const char* source_path;
+#if defined(__linux__) || defined(MITE_KQUEUE)
+	int fd;
+	struct {
+		WatchEntry* items;
+		size_t count;
+		size_t capacity;
+	} entries;
+#elif defined(_WIN32)
+	HANDLE dir;
+	OVERLAPPED overlapped;
+	DWORD buffer[16384];
+#endif
+} MiteWatcher;
 
-		char subdir_path[MAX_PATH];
-		join_path(subdir_path, ".", name);
+static bool watch_is_hidden(const char* path) {
+	for (const char* p = path + 1; *p; ++p) {
+		if (p[0] == '/' && p[1] == '.') return true;
+	}
+	return false;
+}
 
-		char sub_search[MAX_PATH];
-		join_path(sub_search, subdir_path, "*");
+static bool watch_is_relevant(MiteWatcher* w, const char* path) {
+	if (watch_is_hidden(path)) return false;
+	if (is_md_file(path) || is_mite_file(path)) return true;
+	if (g_fingerprint_assets && path[0] == '.' && path[1] == '/' && find_asset(&g_assets, path + 2, strlen(path + 2))) return true;
+	return w->source_path && 0 == strcmp(path, w->source_path);
+}
 
-		WIN32_FIND_DATAA subentry;
-		HANDLE h_sub = FindFirstFileA(sub_search, &subentry);
-		if (h_sub == INVALID_HANDLE_VALUE) continue;
+static void watcher_add_change(MiteWatcher* w, const char* path) {
+	StringView changed = SB_TO_SV(&w->changed);
+	StringView needle = { .items = (char*)path, .count = strlen(path) + 1 };
+	if (changed.count && sv_strstr(changed, needle) < changed.count) return;
+	da_append_many(&w->changed, path, strlen(path) + 1);
+	w->changed_count++;
+}
 
-		do {
-			const char* subname = subentry.cFileName;
-			if (strcmp(subname, ".") == 0 || strcmp(subname, "..") == 0) continue;
+#if defined(__linux__) || defined(MITE_KQUEUE)
+static void watcher_add_entry(MiteWatcher* w, const char* path, bool is_dir) {
+#ifdef __linux__
+	int id = inotify_add_watch(w->fd, path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+	if (id < 0) return;
+#else
+#ifdef O_EVTONLY
+	int id = open(path, O_EVTONLY);
+#else
+	int id = open(path, O_RDONLY);
+#endif
+	if (id < 0) return;
+	struct kevent change;
+	EV_SET(&change, id, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+		NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME | NOTE_ATTRIB, 0, (void*)(uintptr_t)w->entries.count);
+	if (kevent(w->fd, &change, 1, NULL, 0, NULL) < 0) { close(id); return; }
+#endif
+	da_append(&w->entries, ((WatchEntry){ .id = id, .path = strdup(path), .is_dir = is_dir }));
+}
 
-			char path[MAX_PATH];
-			join_path(path, subdir_path, subname);
+static void watcher_add_tree(MiteWatcher* w, const char* path) {
+	watcher_add_entry(w, path, true);
 
-			if (!(subentry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-				if (dir_type == 1 && is_md_file(subname)) register_md_file(pages, subdir_path, subname);
-				if (dir_type > 1 && is_mite_file(subname)) register_mite_file(templates, subdir_path, subname, dir_type == 3);
-			}
+	DIR* dir = opendir(path);
+	if (!dir) return;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.') continue;
+
+		char child[MAX_PATH_LEN*2];
+		join_path(child, path, entry->d_name);
+		bool is_dir = entry->d_type == DT_DIR;
+		if (entry->d_type == DT_UNKNOWN) {
+			struct stat st;
+			is_dir = stat(child, &st) == 0 && S_ISDIR(st.st_mode);
+		}
+		if (is_dir) watcher_add_tree(w, child);
+#ifdef MITE_KQUEUE
+		else if (watch_is_relevant(w, child)) watcher_add_entry(w, child, false);
+#endif
+	}
+	closedir(dir);
+}
 
-			// content
-			if (dir_type == 1 && (subentry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-				char subsub_path[MAX_PATH];
-				join_path(subsub_path, subdir_path, subname);
-
-				char subsub_search[MAX_PATH];
-				join_path(subsub_search, subsub_path, "*");
-
-				WIN32_FIND_DATAA f;
-				HANDLE h_f = FindFirstFileA(subsub_search, &f);
-				if (h_f != INVALID_HANDLE_VALUE) {
-					do {
-						if (!(f.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && is_md_file(f.cFileName)) {
-							register_md_file(pages, subsub_path, f.cFileName);
-						}
-					} while (FindNextFileA(h_f, &f));
-					FindClose(h_f);
-				}
-			}
-		} while (FindNextFileA(h_sub, &subentry));
-		FindClose(h_sub);
-	} while (FindNextFileA(h_find, &find_data));
-	FindClose(h_find);
+static void watcher_clear_entries(MiteWatcher* w) {
+	for (size_t i = 0; i < w->entries.count; ++i) {
+#ifdef MITE_KQUEUE
+		close(w->entries.items[i].id);
 #endif
+		free(w->entries.items[i].path);
+	}
+	w->entries.count = 0;
 }
+#endif
 
+bool watcher_init(MiteWatcher* w) {
+#if defined(__linux__)
+	w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (w->fd < 0) return false;
+	watcher_add_tree(w, ".");
+#elif defined(MITE_KQUEUE)
+	w->fd = kqueue();
+	if (w->fd < 0) return false;
+	watcher_add_tree(w, ".");
+#elif defined(_WIN32)
+	w->dir = CreateFileA(".", FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (w->dir == INVALID_HANDLE_VALUE) return false;
+	w->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+#endif
+	return true;
+}
 
-void second_stage_include_header(StringBuilder* out, const char* source_path) {
-	da_append_cstr(out, "#define SECOND_STAGE\n");
-	da_append_cstr(out, "#include \"");
-	da_append_cstr(out, source_path);
-	da_append_cstr(out, "\"\n\n");
+void watcher_free(MiteWatcher* w) {
+#if defined(__linux__) || defined(MITE_KQUEUE)
+	watcher_clear_entries(w);
+	free(w->entries.items);
+	close(w->fd);
+#elif defined(_WIN32)
+	CancelIo(w->dir);
+	CloseHandle(w->overlapped.hEvent);
+	CloseHandle(w->dir);
+#endif
+	free(w->changed.items);
 }
 
-void second_stage_codegen(StringBuilder* out, MitePages* pages, MiteTemplates* templates) {
-	da_append_cstr(out,
-		"SiteGlobal global = { .title = \"!!!global!title!!!\", .description = \"!!!global!description!!!\" };\n"
-	);
+// reads the pending events, returns false when the wait timed out
+static bool watcher_poll(MiteWatcher* w, int timeout_ms) {
+#if defined(__linux__)
+	struct pollfd pfd = { .fd = w->fd, .events = POLLIN };
+	int ready = poll(&pfd, 1, timeout_ms);
+	if (ready < 0 && errno == EINTR) return true;
+	if (ready <= 0) return false;
+
+	char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(w->fd, buffer, sizeof(buffer))) > 0) {
+		for (char* p = buffer; p < buffer + len; ) {
+			struct inotify_event* e = (struct inotify_event*)p;
+			p += sizeof(struct inotify_event) + e->len;
+			if (e->mask & IN_Q_OVERFLOW) { w->rescan = true; continue; }
+			if (e->len == 0 || e->name[0] == '.') continue;
+
+			WatchEntry* entry = NULL;
+			for (size_t i = 0; i < w->entries.count; ++i) {
+				if (w->entries.items[i].id == e->wd) { entry = &w->entries.items[i]; break; }
+			}
+			if (!entry) continue;
+
+			char path[MAX_PATH_LEN*2];
+			join_path(path, entry->path, e->name);
+			if (e->mask & IN_ISDIR) {
+				w->rescan = true;
+				if (e->mask & (IN_CREATE | IN_MOVED_TO)) watcher_add_tree(w, path);
+			} else if (watch_is_relevant(w, path)) {
+				watcher_add_change(w, path);
+			}
+		}
+	}
+	return true;
 
-	da_append_cstr(out,
-		"void construct_global_state(void) {\n"
-	);
-	for (size_t i = 0; i < pages->count; ++i) {
-		MitePage* mp = &pages->items[i];
-		da_append_cstr(out, "	{\n");
+#elif defined(MITE_KQUEUE)
+	struct kevent events[64];
+	struct timespec timeout = { .tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000L };
+	int ready = kevent(w->fd, NULL, 0, events, 64, timeout_ms < 0 ? NULL : &timeout);
+	if (ready < 0 && errno == EINTR) return true;
+	if (ready <= 0) return false;
+
+	for (int i = 0; i < ready; ++i) {
+		size_t index = (size_t)(uintptr_t)events[i].udata;
+		if (index >= w->entries.count) continue;
+		WatchEntry* entry = &w->entries.items[index];
+		// added or removed entries need new file descriptors
+		if (entry->is_dir || (events[i].fflags & (NOTE_DELETE | NOTE_RENAME))) w->rescan = true;
+		if (!entry->is_dir) watcher_add_change(w, entry->path);
+	}
+	return true;
 
-		da_append_cstr(out, "		SitePage* page = site_page_new_tdu(\"");
-		da_append_cstr(out, mp->name);
-		da_append_cstr(out, "\", NULL, \"");
-		da_append_cstr(out, (mp->final_html_path+1)); // +1 removes the . in the path
-		da_append_cstr(out, "\");\n");
-		da_append_cstr(out, "		page->output = \"");
-		da_append_cstr(out, mp->final_html_path+2); // +2 removes ./
-		da_append_cstr(out, "\";\n");
-		da_append_cstr(out, "		page->input = \"");
-		da_append_cstr(out, mp->md_path);
-		da_append_cstr(out, "\";\n");
+#elif defined(_WIN32)
+	if (!w->overlapped.Internal && !w->overlapped.InternalHigh && !w->overlapped.Offset) {
+		ResetEvent(w->overlapped.hEvent);
+		ReadDirectoryChangesW(w->dir, w->buffer, sizeof(w->buffer), TRUE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE,
+			NULL, &w->overlapped, NULL);
+		w->overlapped.Offset = 1; // request pending
+	}
+	if (WaitForSingleObject(w->overlapped.hEvent, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms) != WAIT_OBJECT_0) return false;
+
+	DWORD bytes = 0;
+	GetOverlappedResult(w->dir, &w->overlapped, &bytes, FALSE);
+	w->overlapped.Internal = w->overlapped.InternalHigh = w->overlapped.Offset = 0;
+	if (bytes == 0) { w->rescan = true; return true; }
+
+	for (char* p = (char*)w->buffer;;) {
+		FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)p;
+		char path[MAX_PATH_LEN] = "./";
+		int len = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR),
+			path + 2, MAX_PATH_LEN - 3, NULL, NULL);
+		path[2 + (len > 0 ? len : 0)] = '\0';
+		for (char* c = path; *c; ++c) if (*c == '\\') *c = '/';
+
+		if (!watch_is_hidden(path)) {
+			if (watch_is_relevant(w, path)) {
+				watcher_add_change(w, path);
+			} else if (info->Action != FILE_ACTION_MODIFIED) {
+				DWORD attrs = GetFileAttributesA(path);
+				if (attrs == INVALID_FILE_ATTRIBUTES || (attrs & FILE_ATTRIBUTE_DIRECTORY)) w->rescan = true;
+			}
+		}
+		if (!info->NextEntryOffset) break;
+		p += info->NextEntryOffset;
+	}
+	return true;
 
-		da_append_cstr(out, "		da_append(&global.pages, page);\n");
+#else
+	(void)w;
+	if (timeout_ms >= 0) return false;
+	sleep(1);
+	w->rescan = true;
+	return true;
+#endif
+}
 
-		da_append_sv(out, &mp->front_matter);
+// blocks until sources change, then collects changes until there are none for MITE_WATCH_DEBOUNCE_MS
+void watcher_wait(MiteWatcher* w) {
+	w->changed.count = 0;
+	w->changed_count = 0;
+	w->rescan = false;
 
-		da_append_cstr(out, "	}\n");
+	while (!w->changed_count && !w->rescan) watcher_poll(w, -1);
+	while (watcher_poll(w, MITE_WATCH_DEBOUNCE_MS)) {}
+
+#ifdef MITE_KQUEUE
+	if (w->rescan) {
+		watcher_clear_entries(w);
+		watcher_add_tree(w, ".");
 	}
-	da_append_cstr(out,
-		"}\n"
-	);
+#endif
+}
+
+
+// ------------------- server ---------------------------
+// a small static file server for --serve, one thread per keep-alive connection.
+// html responses get a script that listens on MITE_RELOAD_PATH, an event stream
+// that tells the browser to reload as soon as a rebuild finished
+#define MITE_DEFAULT_PORT 8000
+#define MITE_RELOAD_PATH "/__mite/reload"
+#define MITE_STATUS_PATH "/__mite/status"
+#define MITE_RELOAD_SCRIPT "<script>new EventSource(\""MITE_RELOAD_PATH"\").onmessage = function() { location.reload(); };</script>\n"
+#define MITE_REQUEST_MAX 8192
+
+#ifndef _WIN32
+	typedef int MiteSocket;
+	#define MITE_INVALID_SOCKET (-1)
+	#define close_socket close
+#else
+	typedef SOCKET MiteSocket;
+	#define MITE_INVALID_SOCKET INVALID_SOCKET
+	#define close_socket closesocket
+#endif
 
-	for (size_t i = 0; i < templates->count; ++i) {
-		MiteTemplate* mt = &templates->items[i];
+// bumped after every build that wrote pages
+static volatile size_t g_build_generation = 0;
 
-		da_append_cstr(out, "void render_template_");
-		da_append_cstr(out, mt->name);
-		da_append_cstr(out, "(StringBuilder* out, SitePage* page, render_content_func_t render_content_func) {\n");
+// the last build, served on MITE_STATUS_PATH
+typedef struct {
+	volatile bool building;
+	volatile int result;
+	volatile size_t pages;
+	volatile size_t dirty;
+	volatile uint64_t build_ns;
+} MiteBuildStatus;
+static MiteBuildStatus g_build_status = {0};
 
-		da_append_many(out, mt->rendered_code.items, mt->rendered_code.count);
+typedef struct {
+	MiteSocket listener;
+	bool live_reload;
+} MiteServer;
 
-		da_append_cstr(out, "}\n");
-	}
+typedef struct {
+	MiteServer* server;
+	MiteSocket socket;
+} MiteConnection;
 
+static void sleep_ms(int ms) {
+#ifndef _WIN32
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+#else
+	Sleep(ms);
+#endif
+}
 
-	da_append_cstr(out,
-		"void construct_templates(void) {\n"
-	);
-	for (size_t i = 0; i < templates->count; ++i) {
-		MiteTemplate* mt = &templates->items[i];
+#ifndef _WIN32
+static bool start_detached_thread(void* (*func)(void*), void* arg) {
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, func, arg) != 0) return false;
+	pthread_detach(thread);
+	return true;
+}
+#else
+static bool start_detached_thread(DWORD (WINAPI *func)(LPVOID), void* arg) {
+	HANDLE thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+	if (!thread) return false;
+	CloseHandle(thread);
+	return true;
+}
+#endif
 
-		da_append_cstr(out,
-			"	{\n"
-			"		da_append(&global.templates, (SiteTemplate){0});\n"
-			"		SiteTemplate* st = &global.templates.items[global.templates.count-1];\n"
-			"		st->name = \""
-		);
-		da_append_cstr(out, mt->name);
-		da_append_cstr(out, "\";\n"
-			"		st->function = render_template_"
-		);
-		da_append_cstr(out, mt->name);
-		da_append_cstr(out, ";\n"
-			"		st->is_include = "
-		);
-		da_append_cstr(out, mt->is_include ? "1": "0");
-		da_append_cstr(out, ";\n\t}\n");
+static bool send_all(MiteSocket s, const char* data, size_t count) {
+	while (count > 0) {
+		int sent = send(s, data, (int)(count > 1<<30 ? 1<<30 : count), 0);
+		if (sent <= 0) return false;
+		data += sent;
+		count -= sent;
 	}
-	da_append_cstr(out,
-		"}\n"
-	);
+	return true;
+}
 
+// sends the file with the zero-copy path of the os when there is one
+static bool send_file(MiteSocket s, const char* path, uint64_t size) {
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+	bool ok = true;
+#if defined(__linux__)
+	off_t offset = 0;
+	while (ok && (uint64_t)offset < size) {
+		ssize_t sent = sendfile(s, fd, &offset, size - offset);
+		if (sent <= 0) ok = false;
+	}
+#elif defined(__APPLE__)
+	off_t offset = 0;
+	while (ok && (uint64_t)offset < size) {
+		off_t len = size - offset;
+		if (sendfile(fd, s, offset, &len, NULL, 0) < 0 && len == 0) ok = false;
+		offset += len;
+	}
+#else
+	char buffer[65536];
+	ssize_t len;
+	while (ok && (len = read(fd, buffer, sizeof(buffer))) > 0) ok = send_all(s, buffer, (size_t)len);
+#endif
+	close(fd);
+	return ok;
+#else
+	(void)size;
+	StringBuilder sb = {0};
+	bool ok = read_entire_file(path, &sb) && send_all(s, sb.items, sb.count);
+	free(sb.items);
+	return ok;
+#endif
+}
 
-	for (size_t i = 0; i < pages->count; ++i) {
-		MitePage* mp = &pages->items[i];
+static const char* content_type(const char* path) {
+	static const char* types[][2] = {
+		{ ".html", "text/html; charset=utf-8" },
+		{ ".css",  "text/css; charset=utf-8" },
+		{ ".js",   "text/javascript; charset=utf-8" },
+		{ ".json", "application/json" },
+		{ ".xml",  "application/xml; charset=utf-8" },
+		{ ".txt",  "text/plain; charset=utf-8" },
+		{ ".svg",  "image/svg+xml" },
+		{ ".png",  "image/png" },
+		{ ".jpg",  "image/jpeg" },
+		{ ".jpeg", "image/jpeg" },
+		{ ".gif",  "image/gif" },
+		{ ".webp", "image/webp" },
+		{ ".ico",  "image/x-icon" },
+		{ ".mp4",  "video/mp4" },
+		{ ".webm", "video/webm" },
+		{ ".woff2","font/woff2" },
+		{ ".pdf",  "application/pdf" },
+	};
+	for (size_t i = 0; i < sizeof(types)/sizeof(types[0]); ++i) {
+		if (ends_with(path, types[i][0])) return types[i][1];
+	}
+	return "application/octet-stream";
+}
 
-		da_append_cstr(out, "void render_");
-		da_append_cstr(out, mp->name);
-		da_append_cstr(out, "(StringBuilder* out, SitePage* page) {\n");
-		da_append_cstr(out, "	render_content_func_t render_content_func = NULL;\n");
+static bool is_directory(const char* path) {
+#ifndef _WIN32
+	struct stat st;
+	return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#else
+	DWORD attrs = GetFileAttributesA(path);
+	return attrs != INVALID_FILE_ATTRIBUTES && (attrs & FILE_ATTRIBUTE_DIRECTORY);
+#endif
+}
+
+static int strncasecmp_ascii(const char* a, const char* b, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		int ca = tolower((unsigned char)a[i]), cb = tolower((unsigned char)b[i]);
+		if (ca != cb || ca == 0) return ca - cb;
+	}
+	return 0;
+}
 
+// finds the value of a request header, NULL if it is not there
+static const char* find_header(const char* request, const char* name, size_t* len) {
+	size_t name_len = strlen(name);
+	for (const char* line = strstr(request, "\r\n"); line && line[2] != '\r'; line = strstr(line + 2, "\r\n")) {
+		const char* h = line + 2;
+		if (strncasecmp_ascii(h, name, name_len) != 0 || h[name_len] != ':') continue;
+		h += name_len + 1;
+		while (*h == ' ') h++;
+		const char* end = strstr(h, "\r\n");
+		*len = end ? (size_t)(end - h) : strlen(h);
+		return h;
+	}
+	return NULL;
+}
 
-		da_append_many(out, mp->rendered_code.items, mp->rendered_code.count);
+static void send_status(MiteSocket s, const char* status, bool keep_alive) {
+	char response[256];
+	snprintf(response, sizeof(response),
+		"HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\nConnection: %s\r\n\r\n%s\n",
+		status, (int)strlen(status) + 1, keep_alive ? "keep-alive" : "close", status);
+	send_all(s, response, strlen(response));
+}
 
-		da_append_cstr(out, "}\n");
+static void serve_reload_events(MiteSocket s) {
+	const char* headers =
+		"HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-store\r\nConnection: keep-alive\r\n\r\n"
+		": connected\n\n";
+	if (!send_all(s, headers, strlen(headers))) return;
+
+	size_t generation = g_build_generation;
+	for (int idle = 0;; idle++) {
+		sleep_ms(50);
+		if (generation != g_build_generation) {
+			generation = g_build_generation;
+			idle = 0;
+			if (!send_all(s, "data: reload\n\n", 14)) return;
+		} else if (idle >= 300) {
+			// notices closed tabs
+			idle = 0;
+			if (!send_all(s, ": ping\n\n", 8)) return;
+		}
 	}
+}
 
-	da_append_cstr(out,
-		"int main(void) {\n"
-		"	construct_global_state();\n"
-		"	construct_templates();\n"
-		"	StringBuilder out = {0};\n\n"
-	);
+static void serve_build_status(MiteSocket s, bool keep_alive) {
+	char body[256];
+	snprintf(body, sizeof(body),
+		"{\"generation\":%d,\"building\":%s,\"result\":%d,\"pages\":%d,\"dirty\":%d,\"build_ms\":%.1f}\n",
+		(int)g_build_generation, g_build_status.building ? "true" : "false", g_build_status.result,
+		(int)g_build_status.pages, (int)g_build_status.dirty, g_build_status.build_ns / 1e6);
+	char response[512];
+	snprintf(response, sizeof(response),
+		"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nCache-Control: no-store\r\nContent-Length: %d\r\nConnection: %s\r\n\r\n%s",
+		(int)strlen(body), keep_alive ? "keep-alive" : "close", body);
+	send_all(s, response, strlen(response));
+}
 
-	for (size_t i = 0; i < pages->count; ++i) {
-		MitePage* mp = &pages->items[i];
+// handles one request, returns false when the connection should be closed
+static bool serve_request(MiteServer* server, MiteSocket s, char* request) {
+	char method[16], target[MAX_PATH_LEN], version[16];
+	if (3 != sscanf(request, "%15s %1023s %15s", method, target, version)) {
+		send_status(s, "400 Bad Request", false);
+		return false;
+	}
 
-		da_append_cstr(out, "	{\n");
+	size_t len = 0;
+	const char* connection = find_header(request, "Connection", &len);
+	bool keep_alive = 0 == strcmp(version, "HTTP/1.1");
+	if (connection && len == 5 && 0 == strncasecmp_ascii(connection, "close", 5)) keep_alive = false;
+	if (connection && len == 10 && 0 == strncasecmp_ascii(connection, "keep-alive", 10)) keep_alive = true;
 
-		da_append_cstr(out, "		SitePage* page = find_page(&global.pages, \"");
-		da_append_cstr(out, mp->md_path);
-		da_append_cstr(out, "\");\n");
-		da_append_cstr(out, "		printf(\"[rendering] %s\\n\", page->output);\n");
+	bool head = 0 == strcmp(method, "HEAD");
+	if (!head && 0 != strcmp(method, "GET")) {
+		send_status(s, "405 Method Not Allowed", keep_alive);
+		return keep_alive;
+	}
 
-		da_append_cstr(out, "		SiteTemplate* st = find_template(&global.templates, page->layout);\n");
-		da_append_cstr(out, "		if (st) st->function(&out, page, render_");
-		da_append_cstr(out, mp->name);
-		da_append_cstr(out, ");\n");
-		da_append_cstr(out, "		else render_");
-		da_append_cstr(out, mp->name);
-		da_append_cstr(out, "(&out, page);\n");
+	char* query = strchr(target, '?');
+	if (query) *query = '\0';
+	if (0 == strcmp(target, MITE_RELOAD_PATH)) {
+		serve_reload_events(s);
+		return false;
+	}
+	if (0 == strcmp(target, MITE_STATUS_PATH)) {
+		serve_build_status(s, keep_alive);
+		return keep_alive;
+	}
 
-		da_append_cstr(out, "		write_to_file(page->output, &out);\n");
-		da_append_cstr(out, "		out.count = 0;\n");
+	// decode the path, hidden files and anything outside the site stay private
+	char path[MAX_PATH_LEN + 16] = ".";
+	size_t p = 1;
+	for (const char* c = target; *c && p < MAX_PATH_LEN; ++c) {
+		if (c[0] == '%' && isxdigit((unsigned char)c[1]) && isxdigit((unsigned char)c[2])) {
+			char hex[3] = { c[1], c[2], 0 };
+			path[p++] = (char)strtol(hex, NULL, 16);
+			c += 2;
+		} else {
+			path[p++] = *c;
+		}
+	}
+	path[p] = '\0';
+	if (path[1] != '/' || strstr(path, "/.") || strchr(path, '\\')) {
+		send_status(s, "404 Not Found", keep_alive);
+		return keep_alive;
+	}
 
+	if (is_directory(path)) {
+		if (path[p-1] != '/') {
+			char response[MAX_PATH_LEN + 128];
+			snprintf(response, sizeof(response),
+				"HTTP/1.1 301 Moved Permanently\r\nLocation: %s/\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+				target, keep_alive ? "keep-alive" : "close");
+			send_all(s, response, strlen(response));
+			return keep_alive;
+		}
+		strcat(path, "index.html");
+	}
 
-		da_append_cstr(out, "	}\n");
+	uint64_t mtime = 0, size = 0;
+	if (!get_file_info(path, &mtime, &size) || is_directory(path)) {
+		send_status(s, "404 Not Found", keep_alive);
+		return keep_alive;
 	}
 
-	da_append_cstr(out,
-		"	free(out.items);\n"
-		"	return 0;\n"
-		"}"
-	);
+	bool inject = server->live_reload && ends_with(path, ".html");
+	size_t extra = inject ? strlen(MITE_RELOAD_SCRIPT) : 0;
+
+	char etag[64];
+	snprintf(etag, sizeof(etag), "\"%llx-%llx%s\"", (unsigned long long)mtime, (unsigned long long)size, inject ? "-r" : "");
+	const char* if_none_match = find_header(request, "If-None-Match", &len);
+	bool not_modified = if_none_match && len == strlen(etag) && 0 == strncmp(if_none_match, etag, len);
+
+	char last_modified[64] = {0};
+	time_t seconds = (time_t)(mtime / 1000000000ULL);
+	struct tm* gmt = gmtime(&seconds);
+	if (gmt) strftime(last_modified, sizeof(last_modified), "%a, %d %b %Y %H:%M:%S GMT", gmt);
+
+	char headers[1024];
+	snprintf(headers, sizeof(headers),
+		"HTTP/1.1 %s\r\n"
+		"Content-Type: %s\r\n"
+		"Content-Length: %llu\r\n"
+		"Cache-Control: no-cache\r\n"
+		"ETag: %s\r\n"
+		"Last-Modified: %s\r\n"
+		"Connection: %s\r\n\r\n",
+		not_modified ? "304 Not Modified" : "200 OK", content_type(path),
+		not_modified ? 0ULL : (unsigned long long)(size + extra), etag, last_modified,
+		keep_alive ? "keep-alive" : "close");
+	if (!send_all(s, headers, strlen(headers))) return false;
+	if (head || not_modified) return keep_alive;
+
+	if (!send_file(s, path, size)) return false;
+	if (inject && !send_all(s, MITE_RELOAD_SCRIPT, extra)) return false;
+	return keep_alive;
 }
 
-uint64_t get_modification_time(const char *path_cstr) {
 #ifndef _WIN32
-	struct stat st;
-	if (stat(path_cstr, &st) != 0) return 0;
-	return (uint64_t)st.st_mtime;
+static void* serve_connection(void* arg) {
 #else
-	WIN32_FILE_ATTRIBUTE_DATA attr;
-	if (!GetFileAttributesExA(path_cstr, GetFileExInfoStandard, &attr)) return 0;
-
-	FILETIME ft = attr.ftLastWriteTime;
-	ULARGE_INTEGER ull;
-	ull.LowPart  = ft.dwLowDateTime;
-	ull.HighPart = ft.dwHighDateTime;
-
-	return (ull.QuadPart - 116444736000000000ULL) / 10000000ULL;
+static DWORD WINAPI serve_connection(LPVOID arg) {
 #endif
-}
-
-bool check_need_to_render(MitePages* pages, MiteTemplates* templates) {
-	uint64_t most_recent_template = 0;
+	MiteConnection* c = arg;
+	char request[MITE_REQUEST_MAX + 1];
+	request[0] = '\0';
+	size_t count = 0;
 
-	for (size_t i = 0; i < templates->count; ++i) {
-		MiteTemplate* mt = &templates->items[i];
-		uint64_t time = get_modification_time(mt->path);
-		if (time > most_recent_template) most_recent_template = time;
+	for (;;) {
+		char* end = NULL;
+		while (!(end = strstr(request, "\r\n\r\n"))) {
+			if (count >= MITE_REQUEST_MAX) goto done;
+			int received = recv(c->socket, request + count, (int)(MITE_REQUEST_MAX - count), 0);
+			if (received <= 0) goto done;
+			count += received;
+			request[count] = '\0';
+		}
+		end += 4;
+		char saved = *end;
+		*end = '\0';
+		bool keep_alive = serve_request(c->server, c->socket, request);
+		*end = saved;
+		if (!keep_alive) break;
+
+		// pipelined requests stay in the buffer
+		count -= end - request;
+		memmove(request, end, count);
+		request[count] = '\0';
 	}
 
-	for (size_t i = 0; i < pages->count; ++i) {
-		MitePage* mp = &pages->items[i];
-		uint64_t time_html = get_modification_time(mp->final_html_path);
-		uint64_t time_md   = get_modification_time(mp->md_path);
+done:
+	close_socket(c->socket);
+	free(c);
+	return 0;
+}
 
-		if (time_md > time_html) return true;
-		if (most_recent_template > time_html) return true;
+bool server_start(MiteServer* server, int port) {
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN);
+#else
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+#endif
+	server->listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (server->listener == MITE_INVALID_SOCKET) return false;
+
+	int yes = 1;
+	setsockopt(server->listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons((unsigned short)port);
+	if (bind(server->listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server->listener, 64) != 0) {
+		close_socket(server->listener);
+		return false;
 	}
+	return true;
+}
 
-	return false;
+#ifndef _WIN32
+static void* server_accept_loop(void* arg) {
+#else
+static DWORD WINAPI server_accept_loop(LPVOID arg) {
+#endif
+	MiteServer* server = arg;
+	for (;;) {
+		MiteSocket s = accept(server->listener, NULL, NULL);
+		if (s == MITE_INVALID_SOCKET) continue;
+		int yes = 1;
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+
+		MiteConnection* c = calloc(1, sizeof(MiteConnection));
+		c->server = server;
+		c->socket = s;
+		if (!start_detached_thread(serve_connection, c)) {
+			close_socket(s);
+			free(c);
+		}
+	}
+	return 0;
 }
 
 
 typedef struct {
 	MitePages pages;
 	MiteTemplates templates;
+	MiteSourceDirs dirs;
+	PathArena paths;
 	const char* mite_source_path;
 
 	StringBuilder second_stage;
+	MiteHost host;
 
 	bool arg_first_stage;
 	bool arg_keep;
@@ -1529,75 +6182,495 @@ typedef struct {
 	bool arg_watch;
 	bool arg_incremental;
 	bool arg_no_watcher;
+	bool arg_split;
+	bool arg_daemon;
+	size_t arg_jobs;
+	int arg_port;
 } MiteGenerator;
 
-int mite_generate(MiteGenerator* m) {
-	while(m->arg_watch) watch();
+uint64_t hash_file(const char* path) {
+	StringBuilder sb = {0};
+	uint64_t hash = read_entire_file(path, &sb) ? hash_bytes(sb.items, sb.count) : 0;
+	free(sb.items);
+	return hash;
+}
+
+// the layout of a page repeats its savings in the output, includes are not counted
+void minify_report(MitePages* pages, MiteTemplates* templates) {
+	size_t template_before = 0, template_after = 0;
+	size_t page_before = 0, page_after = 0;
+	size_t output_saved = 0;
+	for (size_t i = 0; i < templates->count; ++i) {
+		MiteTemplate* mt = &templates->items[i];
+		template_before += mt->html_size + mt->html_saved;
+		template_after += mt->html_size;
+	}
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		if (!mp->dirty) continue;
+		page_before += mp->html_size + mp->html_saved;
+		page_after += mp->html_size;
+		StringView deps = SB_TO_SV(&mp->deps);
+		MiteTemplate* layout = find_mite_template(templates, chop_until(&deps, " ", 1));
+		output_saved += mp->html_saved + (layout ? layout->html_saved : 0);
+	}
+	printf("[minify] templates %.1f KB -> %.1f KB, pages %.1f KB -> %.1f KB, output at least %.1f KB smaller\n",
+		template_before / 1024.0, template_after / 1024.0, page_before / 1024.0, page_after / 1024.0, output_saved / 1024.0);
+}
 
+int mite_build_phases(MiteGenerator* m) {
 	if (m->pages.count == 0) {
 		printf("[done] nothing to do\n");
 		return 0;
 	}
 
-	bool need_to_render = m->arg_incremental ? check_need_to_render(&m->pages, &m->templates) : true;
-	int result = 0;
+	m->second_stage.count = 0;
+	// pages the watcher saw no change in keep their code from the last build
+	for (size_t i = 0; i < m->pages.count; ++i) {
+		MitePage* mp = &m->pages.items[i];
+		if (mp->unchanged && mp->rendered) continue;
+		mp->rendered = false;
+		mp->rendered_code.count = 0;
+	}
 
-	if (need_to_render) {
-		render_all(&m->pages, &m->templates);
+	size_t phase = timing_begin("templates");
+	render_templates(&m->templates, m->arg_jobs);
+	timing_end(phase);
+
+	phase = timing_begin("check");
+	MiteCache cache = {0};
+	if (m->arg_incremental) load_cache(&cache);
+	uint64_t source_hash = hash_file(m->mite_source_path);
+	// options that change the generated code invalidate the cache like a new mite.c
+	if (g_minify_html) source_hash ^= hash_bytes("--minify", 8);
+	// sidecars of pages that are not rendered are written by a full build
+	if (g_compress_output) source_hash ^= hash_bytes("--compress", 10);
+	// an asset that changed relinks every page
+	uint64_t build_hash = source_hash;
+	if (g_fingerprint_assets) {
+		source_hash ^= hash_bytes("--fingerprint", 13);
+		build_hash = source_hash ^ assets_refresh(&g_assets, &cache);
+	}
+	size_t dirty = check_need_to_render(&m->pages, &m->templates, &cache, build_hash, m->arg_jobs);
+	bool dirs_changed = !cache_dirs_match(&cache, &m->dirs);
+	free_cache(&cache);
+	timing_end(phase);
 
-		second_stage_include_header(&m->second_stage, m->mite_source_path);
-		second_stage_codegen(&m->second_stage, &m->pages, &m->templates);
-		write_to_file("site.c", &m->second_stage);
-		printf("[generated] site\n");
+	int result = 0;
 
-		if (m->arg_first_stage) return 0;
+	if (dirty == 0) {
+		// keep the stat info of touched but unchanged pages and directories
+		bool save = dirs_changed;
+		for (size_t i = 0; i < m->pages.count && !save; ++i) save = m->pages.items[i].rendered && !m->pages.items[i].unchanged;
+		if (save) save_cache(&m->pages, &m->templates, &m->dirs, build_hash);
+		printf("[done] nothing to do\n");
+	} else {
+		phase = timing_begin("pages");
+		render_pages(&m->pages, m->arg_jobs);
+		timing_end(phase);
+		for (size_t i = 0; i < m->pages.count; ++i) {
+			MitePage* mp = &m->pages.items[i];
+			uint64_t mtime = 0;
+			mp->output_size = 0;
+			if (mp->dirty) get_file_info(page_output_path(mp), &mtime, &mp->output_size);
+		}
+		if (g_minify_html) minify_report(&m->pages, &m->templates);
+		if (g_fingerprint_assets) {
+			assets_collect(&g_assets, &m->pages, &m->templates);
+			build_hash = source_hash ^ assets_digest(&g_assets);
+		}
+		g_render_serial = !check_parallel_sorts(&m->pages, &m->templates, m->arg_jobs > 1);
+		if (!check_templates_exist(&m->pages, &m->templates)) {
+			printf("[failed]\n");
+			return 1;
+		}
 
-		result = build_and_run_site();
-		if (result == 0 && !m->arg_keep) cleanup_site();
+		if (m->arg_split && !m->arg_first_stage) {
+#ifdef MITE_HOT_RELOAD
+			MiteHost* host = m->arg_daemon ? &m->host : NULL;
+#else
+			MiteHost* host = NULL;
+#endif
+			result = build_and_run_split_site(&m->pages, &m->templates, m->mite_source_path, source_hash, m->arg_jobs, host);
+			if (result == 0 && !m->arg_keep) remove(SITE_BINARY);
+		} else {
+			phase = timing_begin("codegen");
+			codegen_source_hash(&m->second_stage, source_hash);
+			second_stage_include_header(&m->second_stage, m->mite_source_path);
+			second_stage_codegen(&m->second_stage, &m->pages, &m->templates);
+			write_to_file("site.c", &m->second_stage);
+			timing_end(phase);
+			printf("[generated] site\n");
+
+			if (m->arg_first_stage) return 0;
+
+			result = build_and_run_site(&m->second_stage, m->arg_jobs, m->arg_incremental,
+										m->arg_watch || m->arg_serve || m->arg_daemon);
+			if (result == 0 && !m->arg_keep) cleanup_site();
+		}
+		if (result == 0) save_cache(&m->pages, &m->templates, &m->dirs, build_hash);
+		if (result == 0) atomic_fetch_add_size(&g_build_generation, 1);
 
-		if (result == 0) printf("[done]\n");
+		if (result == 0) printf("[done] %d/%d pages\n", (int)dirty, (int)m->pages.count);
 		else             printf("[failed]\n");
 	}
+	return result;
+}
+
+typedef struct {
+	uint64_t start;
+	uint64_t render;
+	uint64_t write;
+	uint64_t bytes;
+	int worker;
+	int result;
+	StringView output;
+} SiteTimingRecord;
+
+typedef struct {
+	SiteTimingRecord* items;
+	size_t count;
+	size_t capacity;
+} SiteTimingRecords;
+
+static int site_timing_compare(const void* a, const void* b) {
+	const SiteTimingRecord* x = a;
+	const SiteTimingRecord* y = b;
+	uint64_t tx = x->render + x->write;
+	uint64_t ty = y->render + y->write;
+	return tx < ty ? 1 : tx > ty ? -1 : 0;
+}
+
+static int page_timing_compare(const void* a, const void* b) {
+	const MitePage* x = *(MitePage* const*)a;
+	const MitePage* y = *(MitePage* const*)b;
+	return x->render_ns < y->render_ns ? 1 : x->render_ns > y->render_ns ? -1 : 0;
+}
+
+static int unit_timing_compare(const void* a, const void* b) {
+	const MiteUnitTiming* x = a;
+	const MiteUnitTiming* y = b;
+	return x->span.wall < y->span.wall ? 1 : x->span.wall > y->span.wall ? -1 : 0;
+}
+
+// loads what the site wrote to MITE_TIMINGS_PATH, data owns the strings of the records
+static void load_site_timings(StringBuilder* data, SiteTimingRecords* records, uint64_t* start, uint64_t* end) {
+	if (!file_exists(MITE_TIMINGS_PATH) || !read_entire_file(MITE_TIMINGS_PATH, data)) return;
+	remove(MITE_TIMINGS_PATH);
+	da_append(data, '\0');
+
+	StringView input = SB_TO_SV(data);
+	input.count--;
+	while (input.count) {
+		StringView line = sv_chop_line(&input);
+		line.items[line.count] = '\0';
+		unsigned long long a, b, c, bytes;
+		int worker, result, n = 0;
+		if (line.count > 7 && 0 == strncmp(line.items, "render ", 7)) {
+			if (2 == sscanf(line.items, "render %llu %llu", &a, &b)) { *start = a; *end = b; }
+		} else if (line.count > 5 && 0 == strncmp(line.items, "page ", 5)) {
+			if (6 != sscanf(line.items, "page %llu %llu %llu %llu %d %d %n", &a, &b, &c, &bytes, &worker, &result, &n) || n == 0) continue;
+			da_append(records, ((SiteTimingRecord){
+				.start = a, .render = b, .write = c, .bytes = bytes, .worker = worker, .result = result,
+				.output = { .items = line.items + n, .count = line.count - n },
+			}));
+		}
+	}
+}
+
+static void da_append_json_string(StringBuilder* sb, const char* str, size_t len) {
+	da_append(sb, '"');
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = (unsigned char)str[i];
+		if (c == '"' || c == '\\') {
+			da_append(sb, '\\');
+			da_append(sb, c);
+		} else if (c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			da_append_cstr(sb, escaped);
+		} else {
+			da_append(sb, c);
+		}
+	}
+	da_append(sb, '"');
+}
+
+static void trace_event(StringBuilder* sb, const char* name, size_t name_len, const char* cat,
+						uint64_t start, uint64_t duration, uint64_t epoch, int pid, int tid, const char* args) {
+	char buffer[256];
+	da_append_cstr(sb, ",\n{\"name\":");
+	da_append_json_string(sb, name, name_len);
+	snprintf(buffer, sizeof(buffer), ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+		cat, (double)(start - epoch) / 1e3, (double)duration / 1e3, pid, tid);
+	da_append_cstr(sb, buffer);
+	if (args) {
+		da_append_cstr(sb, ",\"args\":");
+		da_append_cstr(sb, args);
+	}
+	da_append(sb, '}');
+}
+
+// chrome://tracing and ui.perfetto.dev, mite is pid 1, the site pid 2 and the compiler pid 3,
+// workers and parallel compiles are threads
+static void write_trace(MitePages* pages, SiteTimingRecords* records, uint64_t site_start, uint64_t site_end) {
+	uint64_t epoch = g_timings.count ? g_timings.items[0].start : site_start;
+	for (size_t i = 0; i < g_timings.count; ++i) {
+		if (g_timings.items[i].start < epoch) epoch = g_timings.items[i].start;
+	}
+
+	StringBuilder sb = {0};
+	char args[128];
+	da_append_cstr(&sb, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"mite\"}},\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"site\"}},\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":3,\"args\":{\"name\":\"cc\"}}");
+
+	for (size_t i = 0; i < g_timings.count; ++i) {
+		MitePhase* p = &g_timings.items[i];
+		snprintf(args, sizeof(args), "{\"cpu_ms\":%.3f}", (double)p->cpu / 1e6);
+		trace_event(&sb, p->name, strlen(p->name), "phase", p->start, p->wall, epoch, 1, 0, args);
+	}
+	for (size_t i = 0; i < pages->count; ++i) {
+		MitePage* mp = &pages->items[i];
+		if (!mp->render_ns) continue;
+		const char* name = mp->md_path + 2;
+		trace_event(&sb, name, strlen(name), "page", mp->render_start, mp->render_ns, epoch, 1, (int)mp->render_worker + 1, NULL);
+	}
+	// the units are in the order they started, each takes the first thread that is free by then
+	uint64_t* threads = calloc(g_timings.units.count + 1, sizeof(uint64_t));
+	size_t thread_count = 0;
+	for (size_t i = 0; i < g_timings.units.count; ++i) {
+		MiteUnitTiming* u = &g_timings.units.items[i];
+		size_t t = 0;
+		while (t < thread_count && threads[t] > u->span.start) t++;
+		if (t == thread_count) thread_count++;
+		threads[t] = u->span.start + u->span.wall;
+		trace_event(&sb, u->name, strlen(u->name), "compile", u->span.start, u->span.wall, epoch, 3, (int)t + 1, NULL);
+	}
+	free(threads);
+	if (site_end > site_start) {
+		trace_event(&sb, "render", 6, "phase", site_start, site_end - site_start, epoch, 2, 0, NULL);
+	}
+	for (size_t i = 0; i < records->count; ++i) {
+		SiteTimingRecord* r = &records->items[i];
+		snprintf(args, sizeof(args), "{\"bytes\":%llu,\"written\":%s}",
+			(unsigned long long)r->bytes, r->result == WRITE_WRITTEN ? "true" : "false");
+		trace_event(&sb, r->output.items, r->output.count, "render", r->start, r->render, epoch, 2, r->worker + 1, args);
+		trace_event(&sb, "write", 5, "write", r->start + r->render, r->write, epoch, 2, r->worker + 1, NULL);
+	}
+	da_append_cstr(&sb, "\n]}\n");
+
+	if (make_directory(MITE_BUILD_DIR) && write_to_file(MITE_TRACE_PATH, &sb)) {
+		printf("[timings] trace written to %s\n", MITE_TRACE_PATH);
+	}
+	free(sb.items);
+}
+
+// prints the phases and the slowest pages of the last build, then forgets them
+void timings_report(MitePages* pages) {
+	StringBuilder data = {0};
+	SiteTimingRecords records = {0};
+	uint64_t site_start = 0, site_end = 0;
+	load_site_timings(&data, &records, &site_start, &site_end);
+
+	printf("[timings] %-12s %10s %10s\n", "phase", "wall ms", "cpu ms");
+	for (size_t i = 0; i < g_timings.count; ++i) {
+		MitePhase* p = &g_timings.items[i];
+		printf("[timings] %-12s %10.2f %10.2f\n", p->name, (double)p->wall / 1e6, (double)p->cpu / 1e6);
+	}
+	if (site_end > site_start) {
+		printf("[timings] %-12s %10.2f %10s\n", "site render", (double)(site_end - site_start) / 1e6, "-");
+	}
+
+	if (records.count) {
+		qsort(records.items, records.count, sizeof(SiteTimingRecord), site_timing_compare);
+		printf("[timings] slowest pages in the site:\n");
+		for (size_t i = 0; i < records.count && i < MITE_TIMINGS_TOP; ++i) {
+			SiteTimingRecord* r = &records.items[i];
+			printf("[timings] %10.2f ms  render %8.2f  write %8.2f  %8.1f KB  %.*s\n",
+				(double)(r->render + r->write) / 1e6, (double)r->render / 1e6, (double)r->write / 1e6,
+				(double)r->bytes / 1024.0, (int)r->output.count, r->output.items);
+		}
+	}
+
+	size_t rendered = 0;
+	MitePage** slowest = calloc(pages->count + 1, sizeof(MitePage*));
+	for (size_t i = 0; i < pages->count; ++i) {
+		if (pages->items[i].render_ns) slowest[rendered++] = &pages->items[i];
+	}
+	if (rendered) {
+		qsort(slowest, rendered, sizeof(MitePage*), page_timing_compare);
+		printf("[timings] slowest pages in mite:\n");
+		for (size_t i = 0; i < rendered && i < MITE_TIMINGS_TOP; ++i) {
+			printf("[timings] %10.2f ms  %s\n", (double)slowest[i]->render_ns / 1e6, slowest[i]->md_path + 2);
+		}
+	}
+
+	if (g_timings.units.count) {
+		// sorted on a copy, the trace wants them in the order they started
+		MiteUnitTiming* units = malloc(g_timings.units.count * sizeof(MiteUnitTiming));
+		memcpy(units, g_timings.units.items, g_timings.units.count * sizeof(MiteUnitTiming));
+		qsort(units, g_timings.units.count, sizeof(MiteUnitTiming), unit_timing_compare);
+		printf("[timings] slowest units to compile:\n");
+		for (size_t i = 0; i < g_timings.units.count && i < MITE_TIMINGS_TOP; ++i) {
+			printf("[timings] %10.2f ms  %s\n", (double)units[i].span.wall / 1e6, units[i].name);
+		}
+		free(units);
+	}
+
+	write_trace(pages, &records, site_start, site_end);
+
+	for (size_t i = 0; i < pages->count; ++i) pages->items[i].render_ns = 0;
+	for (size_t i = 0; i < g_timings.units.count; ++i) free(g_timings.units.items[i].name);
+	g_timings.units.count = 0;
+	g_timings.count = 0;
+	free(slowest);
+	free(records.items);
+	free(data.items);
+}
+
+int mite_build(MiteGenerator* m) {
+	g_build_status.building = true;
+	uint64_t start = timing_now_ns();
+	int result = mite_build_phases(m);
+	size_t dirty = 0;
+	for (size_t i = 0; i < m->pages.count; ++i) if (m->pages.items[i].dirty) dirty++;
+	g_build_status.build_ns = timing_now_ns() - start;
+	g_build_status.pages = m->pages.count;
+	g_build_status.dirty = dirty;
+	g_build_status.result = result;
+	g_build_status.building = false;
+	if (g_timings.enabled) timings_report(&m->pages);
+	return result;
+}
+
+void free_mite_sources(MiteGenerator* m);
+
+// the cached scan is only trusted when the rest of the cache is
+void mite_search(MiteGenerator* m) {
+	size_t phase = timing_begin("search");
+	MiteCache cache = {0};
+	if (m->arg_incremental) load_cache(&cache);
+	search_files(&m->pages, &m->templates, &m->paths, &m->dirs, &cache);
+	free_cache(&cache);
+	timing_end(phase);
+}
+
+// rebuilds in process whenever a source changes, only the changed paths are checked
+int mite_watch(MiteGenerator* m, bool built) {
+	MiteWatcher w = { .source_path = m->mite_source_path };
+	if (!watcher_init(&w)) {
+		printf("[error] could not watch for changes: %s\n", strerror(errno));
+		return 1;
+	}
+
+	m->arg_incremental = true;
+	if (!built) mite_build(m);
+	for (;;) {
+		printf("[watching]\n");
+		fflush(stdout);
+		watcher_wait(&w);
+
+		bool rescan = w.rescan;
+		for (size_t i = 0; i < m->pages.count; ++i) m->pages.items[i].unchanged = true;
+
+		const char* path = w.changed.items;
+		for (size_t c = 0; c < w.changed_count; path += strlen(path) + 1, ++c) {
+			bool known = 0 == strcmp(path, m->mite_source_path);
+			// assets are checked on every build
+			if (g_fingerprint_assets && !known && path[0] == '.' && path[1] == '/') known = find_asset(&g_assets, path + 2, strlen(path + 2)) != NULL;
+			for (size_t i = 0; i < m->pages.count && !known; ++i) {
+				if (0 == strcmp(m->pages.items[i].md_path, path)) {
+					m->pages.items[i].unchanged = false;
+					known = true;
+				}
+			}
+			for (size_t i = 0; i < m->templates.count && !known; ++i) {
+				if (0 == strcmp(m->templates.items[i].path, path)) {
+					m->templates.items[i].rendered_code.count = 0;
+					known = true;
+				}
+			}
+			// a new source appeared or a known one disappeared
+			if (!known || !file_exists(path)) rescan = true;
+		}
+
+		if (rescan) {
+			free_mite_sources(m);
+			mite_search(m);
+		}
+		mite_build(m);
+	}
+
+	watcher_free(&w);
+	return 0;
+}
+
+int mite_generate(MiteGenerator* m) {
+	if (m->arg_watch && !m->arg_serve) return mite_watch(m, false);
+
+	int result = mite_build(m);
 
 	if (result == 0 && m->arg_serve) {
-		printf("[serving]\n");
+		MiteServer server = { .live_reload = !m->arg_no_watcher };
+		int port = m->arg_port > 0 ? m->arg_port : MITE_DEFAULT_PORT;
+		if (!server_start(&server, port)) {
+			printf("[error] could not listen on port %d: %s\n", port, strerror(errno));
+			return 1;
+		}
+		printf("[serving] http://localhost:%d/\n", port);
+		fflush(stdout);
 
-#ifndef _WIN32
-		if (get_mite_binary_path() == NULL) {
-			printf("[error] mite binary not found.\n");
+		if (m->arg_no_watcher) {
+			server_accept_loop(&server);
+		} else if (!start_detached_thread(server_accept_loop, &server)) {
+			printf("[error] could not start the server\n");
 			return 1;
+		} else {
+			result = mite_watch(m, true);
 		}
-#endif
-		if (!m->arg_no_watcher) start_watcher();
-		execute_line("python -m http.server");
-		if (!m->arg_no_watcher) stop_watcher();
+		close_socket(server.listener);
 		printf("[done]\n");
 	}
 	return result;
 }
 
-void free_mite_generator(MiteGenerator* m) {
+void free_mite_sources(MiteGenerator* m) {
 	for (size_t i = 0; i < m->pages.count; ++i) {
 		MitePage* page = &m->pages.items[i];
-		free(page->md_path);
-		free(page->name);
-		free(page->final_html_path);
 		free(page->rendered_code.items);
+		free(page->html.items);
 		free(page->front_matter.items);
+		free(page->deps.items);
+		free(page->output.items);
 	}
 	free(m->pages.items);
 
 	for (size_t i = 0; i < m->templates.count; ++i) {
 		MiteTemplate* t = &m->templates.items[i];
 		if (t->path) {
-			free(t->name);
-			free(t->path);
 			free(t->rendered_code.items);
+			free(t->html.items);
+			free(t->includes.items);
 		}
 	}
 
 	free(m->templates.items);
+	free(m->dirs.items);
+	path_arena_free(&m->paths);
+	m->pages = (MitePages){0};
+	m->templates = (MiteTemplates){0};
+	m->dirs = (MiteSourceDirs){0};
+}
+
+void free_mite_generator(MiteGenerator* m) {
+	free_mite_sources(m);
 	free(m->second_stage.items);
+	free_assets(&g_assets);
+#ifdef MITE_HOT_RELOAD
+	host_stop(&m->host);
+#endif
 }
 
 #define MITE_VERSION_CSTR "[mite v1.4.1]"
@@ -1605,15 +6678,31 @@ void print_usage(const char* prog) {
 	printf(MITE_VERSION_CSTR"\n");
 	printf("usage: %s [options]\n", prog);
 	printf("options:\n");
-	printf("  --serve          build and serve the site with 'python -m http.server', then run the watcher\n");
-	printf("  --no-watcher     do not start a watcher while serving\n");
-	printf("  --incremental    render only if there are changes\n");
+	printf("  --serve          build and serve the site, rebuilding and reloading the browser on changes\n");
+	printf("  --port <N>       port to serve on (default: %d)\n", MITE_DEFAULT_PORT);
+	printf("  --watch          rebuild the pages affected by a change whenever the sources change\n");
+	printf("  --no-watcher     do not watch for changes or reload the browser while serving\n");
+	printf("  --daemon         serve and rebuild like --serve with --split and --incremental, reloading rebuilt pages into a running site\n");
+	printf("  --incremental    render only the pages affected by changes since the last build\n");
 	printf("  --first-stage    only generate site.c, do not compile or run\n");
 	printf("  --keep           keep the generated site.c file\n");
+	printf("  --split          compile every page separately, caching the objects in "MITE_BUILD_DIR"\n");
+	printf("  --minify         collapse the whitespace of static html, except in pre, code, textarea, script and style\n");
+#ifdef MITE_USE_BROTLI
+	printf("  --compress       write a .gz and a .br next to every page\n");
+#else
+	printf("  --compress       write a .gz next to every page\n");
+#endif
+	printf("  --fingerprint    link the assets named by ASSET() and markdown images by the hash of their contents\n");
+	printf("  --stream         write pages of 64 KB and more while rendering them, without copying their static html\n");
+	printf("  --timings        print the wall and cpu time of every phase and the slowest pages, write a trace to "MITE_TRACE_PATH"\n");
+	printf("  -j, --jobs <N>   use up to N threads to convert and render pages, and N compiler jobs with --split (default: 1)\n");
 	printf("  --source <PATH>  path to mite.c source file (default: ./mite.c or /usr/share/mite/mite.c)\n");
 }
 
 
+// bench/bench.c includes mite.c without its main
+#ifndef MITE_NO_MAIN
 int main(int argc, char** argv) {
 	MiteGenerator m = {0};
 
@@ -1630,6 +6719,21 @@ int main(int argc, char** argv) {
 		} else if (0 == strcmp(argv[i], "--watch"))       { m.arg_watch       = true;
 		} else if (0 == strcmp(argv[i], "--incremental")) { m.arg_incremental = true;
 		} else if (0 == strcmp(argv[i], "--no-watcher"))  { m.arg_no_watcher  = true;
+		} else if (0 == strcmp(argv[i], "--split"))       { m.arg_split       = true;
+		} else if (0 == strcmp(argv[i], "--daemon"))      { m.arg_daemon      = true;
+		} else if (0 == strcmp(argv[i], "--timings"))     { g_timings.enabled = true;
+		} else if (0 == strcmp(argv[i], "--minify"))      { g_minify_html     = true;
+		} else if (0 == strcmp(argv[i], "--compress"))    { g_compress_output = true;
+		} else if (0 == strcmp(argv[i], "--fingerprint")) { g_fingerprint_assets = true;
+		} else if (0 == strcmp(argv[i], "--stream"))      { g_stream_output   = true;
+		} else if ((0 == strcmp(argv[i], "-j") || 0 == strcmp(argv[i], "--jobs")) && i + 1 < argc) {
+			int jobs = atoi(argv[++i]);
+			m.arg_jobs = jobs > 0 ? (size_t)jobs : 1;
+		} else if (0 == strncmp(argv[i], "-j", 2) && isdigit((unsigned char)argv[i][2])) {
+			int jobs = atoi(argv[i] + 2);
+			m.arg_jobs = jobs > 0 ? (size_t)jobs : 1;
+		} else if ((0 == strcmp(argv[i], "--port")) && i + 1 < argc) {
+			m.arg_port = atoi(argv[++i]);
 		} else if ((0 == strcmp(argv[i], "--source")) && i + 1 < argc) {
 			m.mite_source_path = argv[++i];
 		} else {
@@ -1659,11 +6763,18 @@ int main(int argc, char** argv) {
 		return 1;
 	}
 
-	search_files(&m.pages, &m.templates);
+	if (m.arg_daemon) {
+		m.arg_serve = m.arg_split = m.arg_incremental = true;
+		m.arg_no_watcher = false;
+	}
+	if (m.arg_watch || m.arg_serve) g_map_sources = false;
+
+	mite_search(&m);
 	int result = mite_generate(&m);
 	free_mite_generator(&m);
 	return result;
 }
+#endif // #ifndef MITE_NO_MAIN
 
 
 #endif // #ifdef SECOND_STAGE #else